@@ -1,4 +1,4 @@
-//MCP4151 digital pot (bitbanged control) for Afterburner GAL project.
+//MCP4151 digital pot (bitbanged control via aftb_spi.h) for Afterburner GAL project.
 //  * compatible with MCP4131 (resolution of the wiper is divided by 2)
 //  * the storage for tap indices is 8bit wide, therefore we must not use index 256.
 
@@ -6,19 +6,13 @@
 #ifndef __AFTB_MCP4131_H__
 #define __AFTB_MCP4131_H__ 
 
+#include "aftb_spi.h"
+
 //set default pins
 #ifndef POT_CS
 #define POT_CS   A3
 #endif
 
-#ifndef POT_CLK
-#define POT_CLK  A4
-#endif
-
-#ifndef POT_DAT
-#define POT_DAT  A5
-#endif
-
 #ifndef POT_DEFAULT_VALUE
 #define POT_DEFAULT_VALUE 0x40
 #endif
@@ -66,8 +60,8 @@ static uint16_t  mcp4131_reg(uint8_t address, uint16_t value, uint8_t read_reg)
     }
 
     //setup Clock and and Data (SPI mode 0,0)
-    digitalWrite(POT_CLK, 0);
-    digitalWrite(POT_DAT, 0);
+    spiClk(0);
+    spiDat(0);
     delayMicroseconds(50);
     //activate IC
     digitalWrite(POT_CS, 0);
@@ -76,25 +70,25 @@ static uint16_t  mcp4131_reg(uint8_t address, uint16_t value, uint8_t read_reg)
         //write address and command (bits 15 to 10)       
         if ((!read_reg) || i > 9) {
             uint16_t mask =  (1 << i);
-            digitalWrite(POT_DAT, (r & mask) ? 1 : 0);
+            spiDat((r & mask) ? 1 : 0);
         }
-        digitalWrite(POT_CLK, 1); //rise the clock
+        spiClk(1); //rise the clock
         //only  when reading reg
         if (read_reg) {
             //switch the DAT pin to Input
             if (i == 10) {
-                 pinMode(POT_DAT, INPUT);
+                 pinMode(SPI_DAT, INPUT);
             }
             //read bits 9 to 0
             if (i < 10) {
-                r |= (digitalRead(POT_DAT) << i); //read after rising edge
+                r |= (spiDatGet() << i); //read after rising edge
             }
         }
-        digitalWrite(POT_CLK, 0); //fall the clock
+        spiClk(0); //fall the clock
         i--;
     }
     if (read_reg) {
-        pinMode(POT_DAT, OUTPUT);
+        pinMode(SPI_DAT, OUTPUT);
     }
 
     if (mcp4131_detected && address == ADDR_WIPER && read_reg) {
@@ -109,8 +103,7 @@ static uint16_t  mcp4131_reg(uint8_t address, uint16_t value, uint8_t read_reg)
 
 static void mcp4131_init(void) {   
     pinMode(POT_CS, OUTPUT);
-    pinMode(POT_CLK, OUTPUT);
-    pinMode(POT_DAT, OUTPUT);
+    spiInit();
 
     digitalWrite(POT_CS, 1); //unselect the POT's SPI bus
 }
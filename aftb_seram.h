@@ -9,141 +9,148 @@ Digi pot and shift register have their own dedicated CS pins. Serial RAM CS is a
 when no other device is selected. Therefore, the serial RAM is always selected unless any other
 device is explicitely selected (in that case serial RAM is de-selected by onboard HW)
 
-Reading or Writing of 1 byte takes ~ 620 uSec for 24bit addressing and ~ 500 uSec for 16bit addressing
+The bus is shared with the digi pot and the shift register, the bits are shifted by aftb_spi.h.
+
+The SHR CS pulse that resets the bus for the serial RAM is also the latch of the shift register.
+Unless the shift clock of the shift register is gated by its CS, the bits of the previous RAM
+transfer sit in the shift register and the pulse would latch them to its outputs (GAL row address
+and control pins), possibly in the middle of a GAL operation. Define SERAM_SHR_VALUE to the value
+the shift register outputs must keep: it is shifted in while the CS is low, so the pulse latches
+the same value again.
+
+The RAM is used in sequential mode: a transfer sends the opcode and the address once and then
+any number of data bytes (burst). The opcode and address phase costs as much as 3 or 4 data bytes,
+therefore bulk data should be moved by seRamWriteBlock() / seRamReadBlock() or by the
+seRamWriteStart() / seRamReadStart() streams rather than by single byte access.
 
  */
 
+#include "aftb_spi.h"
+
 //set default pins
 #ifndef SHR_CS
 #define SHR_CS   A2
 #endif
 
-#ifndef RAM_CLK
-#define RAM_CLK  A4
-#endif
+#define CS_DELAY_US 16
 
-#ifndef RAM_DAT
-#define RAM_DAT  A5
+#ifndef SERAM_SHR_VALUE
+#define SERAM_SHR_VALUE 0
 #endif
 
-#define CS_DELAY_US 16
-
 #define OPCODE_WRITE 2
 #define OPCODE_READ 3
 #define OPCODE_RDMR 5
 #define OPCODE_WRMR 1
 
-#ifndef RAM_BIG
-
-#define seRamInit() 0
+// mode register value: sequential mode - the address auto-increments over the whole array
+#define RAM_MODE_SEQUENTIAL 0x40
 
-#else /* RAM_BIG */
+// serial RAM memory map
+#define SERAM_MAP_ADDR  0x0000 // fusemap of the big GALs (USE_SERAM_FUSEMAP)
+#define SERAM_XSVF_DIR  0x0800 // directory of the cached XSVF streams
+#define SERAM_SLOT_DIR  0x0840 // directory of the fuse map slots
+#define SERAM_SLOT_ADDR 0x1000 // fuse map slots
+#define SERAM_SLOT_SIZE 0x0800 // the biggest fuse map (ATF750C) incl. the APD fuse fits
+#define SERAM_SLOTS     4
+#define SERAM_XSVF_ADDR (SERAM_SLOT_ADDR + SERAM_SLOTS * SERAM_SLOT_SIZE) // cached XSVF streams
+#define SERAM_XSVF_END  0xFFFF // the byte at 0xFFFF is overwritten by seRamInit()
 
 uint8_t ramAddrBits24 = 0;
+uint8_t seRamPresent = 0; // 0: no serial RAM, 1: 64kB, 2: 128kB
 
-static void seRamWriteData(uint16_t data, uint8_t bitLen ) {
-  uint16_t  mask = (1 << (bitLen-1));
-
-  while (bitLen) {
-    bitLen--;
-    //set data bit
-    digitalWrite(RAM_DAT, (data & mask) ? 1 : 0 );
-    //raise the clock
-    digitalWrite(RAM_CLK, 1);
-    //do some operation
-    data <<= 1;
-    //lower the clock
-    digitalWrite(RAM_CLK, 0);
-  }
-}
-
-static uint8_t seRamReadData(void) {
-  uint8_t bitLen = 8;
-  uint8_t result = 0;
-
-  while (bitLen) {
-    result <<= 1;
-    //raise the clock
-    digitalWrite(RAM_CLK, 1);
-    //set data bit
-    result |= digitalRead(RAM_DAT);
-    //do some operation
-    bitLen--;
-    //lower the clock
-    digitalWrite(RAM_CLK, 0);
-  }
-  return result;
-}
+#define seRamWriteData(D, L) spiWrite((D), (L))
+#define seRamReadData() spiRead()
 
-static void seRamWrite(uint16_t addr, uint8_t data ) {
-    //ensure clock is low
-  digitalWrite(RAM_CLK, 0);
+// toggles the SHR CS to reset the bus for serial RAM, the shift register outputs are kept
+static void seRamBusReset(void) {
+  //ensure clock is low
+  spiClk(0);
 
-  // toggle the SHR CS to reset the bus for serial RAM
   digitalWrite(SHR_CS, 0);
+  spiWrite(SERAM_SHR_VALUE, 8); // replace the RAM bits in the shift register before they are latched
   delayMicroseconds(CS_DELAY_US);
   digitalWrite(SHR_CS, 1);
+}
 
-  seRamWriteData(OPCODE_WRITE, 8); // 8 bits of WRITE opcode
+// starts a transfer at the address: the RAM is in sequential mode, therefore
+// the data bytes follow each other with auto-incremented address until the next transfer starts
+static void seRamStart(uint8_t opcode, uint32_t addr) {
+  seRamBusReset();
+
+  seRamWriteData(opcode, 8); // 8 bits of the opcode
   if (ramAddrBits24) {
-    seRamWriteData(0, 8); // top 8 bit of address are 0
+    seRamWriteData(addr >> 16, 8); // top 8 bits of address
   }
   seRamWriteData(addr, 16); // 16 bits of address
-  seRamWriteData(data, 8); // 8 bits of actual data
 }
 
-static uint8_t seRamRead(uint16_t addr) {
-  uint8_t data;
-  //ensure clock is low
-  digitalWrite(RAM_CLK, 0);
+// starts a burst write, the data bytes are then sent by seRamWriteData(D, 8)
+#define seRamWriteStart(A) seRamStart(OPCODE_WRITE, (A))
 
-  // toggle the SHR CS to reset the bus for serial RAM
-  digitalWrite(SHR_CS, 0);
-  delayMicroseconds(CS_DELAY_US);
-  digitalWrite(SHR_CS, 1);
+// starts a burst read, the data bytes are then received by seRamReadData(),
+// the burst read must be finished by seRamReadEnd()
+static void seRamReadStart(uint32_t addr) {
+  seRamStart(OPCODE_READ, addr);
+  pinMode(SPI_DAT, INPUT);
+}
 
-  seRamWriteData(OPCODE_READ, 8); // 8 bits of READ opcode
-  if (ramAddrBits24) {
-    seRamWriteData(0, 8); // top 8 bit of address are 0
+static inline void seRamReadEnd(void) {
+  pinMode(SPI_DAT, OUTPUT);
+}
+
+// writes 'len' bytes from 'data' in one burst
+static void seRamWriteBlock(uint32_t addr, const uint8_t* data, uint16_t len) {
+  seRamWriteStart(addr);
+  while (len--) {
+    seRamWriteData(*data++, 8);
   }
-  seRamWriteData(addr, 16); // 16 bits of address
-  pinMode(RAM_DAT, INPUT);
+}
+
+// reads 'len' bytes into 'data' in one burst
+static void seRamReadBlock(uint32_t addr, uint8_t* data, uint16_t len) {
+  seRamReadStart(addr);
+  while (len--) {
+    *data++ = seRamReadData();
+  }
+  seRamReadEnd();
+}
+
+static void seRamWrite(uint32_t addr, uint8_t data ) {
+  seRamWriteStart(addr);
+  seRamWriteData(data, 8); // 8 bits of actual data
+}
+
+static uint8_t seRamRead(uint32_t addr) {
+  uint8_t data;
+  seRamReadStart(addr);
   data = seRamReadData();
-  pinMode(RAM_DAT, OUTPUT);
+  seRamReadEnd();
   return data;
 }
 
 static void seRamSetupMode(void) {
   uint8_t data;
-  //ensure clock is low
-  digitalWrite(RAM_CLK, 0);
-
-  // toggle the SHR CS to reset the bus for serial RAM
-  digitalWrite(SHR_CS, 0);
-  delayMicroseconds(CS_DELAY_US);
-  digitalWrite(SHR_CS, 1);
+  seRamBusReset();
 
   seRamWriteData(OPCODE_RDMR, 8); // 8 bits of Read Mode register
-  pinMode(RAM_DAT, INPUT);
+  pinMode(SPI_DAT, INPUT);
   data = seRamReadData();
-  pinMode(RAM_DAT, OUTPUT);
+  pinMode(SPI_DAT, OUTPUT);
 
 #if 0
   Serial.print(F("RAM mode:"));
   Serial.println(data, DEC);
 #endif
 
-  if (data == 0) {
+  if (data == RAM_MODE_SEQUENTIAL) {
     return;
   }
 
-  //switch to byte mode
-  // toggle the SHR CS to reset the bus for serial RAM
-  digitalWrite(SHR_CS, 0);
-  delayMicroseconds(CS_DELAY_US);
-  digitalWrite(SHR_CS, 1);
+  //switch to sequential mode
+  seRamBusReset();
   seRamWriteData(OPCODE_WRMR, 8); // 8 bits of Read Mode register
-  seRamWriteData(0, 8); //write mode 0
+  seRamWriteData(RAM_MODE_SEQUENTIAL, 8);
 
 }
 
@@ -152,8 +159,8 @@ static uint8_t seRamInit(void) {
 
 #if 0
   pinMode(SHR_CS, OUTPUT);
-  pinMode(RAM_CLK, OUTPUT);
-  pinMode(RAM_DAT, OUTPUT);
+  pinMode(SPI_CLK, OUTPUT);
+  pinMode(SPI_DAT, OUTPUT);
 #endif
 
   seRamSetupMode();
@@ -187,9 +194,128 @@ static uint8_t seRamInit(void) {
   }
   //verify the data at address 0 still exists
   r = seRamRead(0);
-  return (r == 0x5A) ? (ramAddrBits24 + 1) : 0;
+  seRamPresent = (r == 0x5A) ? (ramAddrBits24 + 1) : 0;
+  return seRamPresent;
+}
+
+#ifdef USE_SERAM_FUSEMAP
+/*
+ Serial RAM backed fusemap.
+
+ Boards with small SRAM keep the fusemap of the big GALs (ATF750C) in the serial RAM
+ when the RAM is detected. The fusemap array in SRAM is used as a direct-mapped
+ write-back cache of 64 byte lines of the fusemap. A line is read from the serial RAM
+ on a cache miss and written back only when it was modified and is evicted.
+ Lines that were never written back are zero: the fusemap is cleared without
+ touching the serial RAM.
+
+ The cache lines are placed after the streaming row slots and the UES/CFG tail
+ (used by the streaming write and the CRC read) at the start of the fusemap array.
+*/
+
+#define SERAM_LINE_SHIFT 6
+#define SERAM_LINE (1 << SERAM_LINE_SHIFT)
+#define SERAM_LINES 16
+#define SERAM_CACHE_OFFSET 256
+
+#if SERAM_CACHE_OFFSET + SERAM_LINES * SERAM_LINE > MAXFUSES
+#error "serial RAM fusemap cache does not fit the fusemap array"
+#endif
+
+uint8_t seRamMapStat = 0; // 1: the fusemap is stored in the serial RAM
+uint8_t seRamTag[SERAM_LINES]; // fusemap line held by the cache slot, 0xFF: none
+uint16_t seRamDirty; // bit per cache slot: the line was modified
+uint32_t seRamLoaded; // bit per fusemap line: the line was written to the serial RAM
+
+static void seRamMapInvalidate(void) {
+  uint8_t i;
+  for (i = 0; i < SERAM_LINES; i++) {
+    seRamTag[i] = 0xFF;
+  }
+  seRamDirty = 0;
+}
+
+// returns the position in the fusemap array where the fusemap byte is cached.
+// The line is marked as modified when 'write' is set.
+static uint16_t seRamMapPos(uint16_t bytePos, char write) {
+  uint8_t line = bytePos >> SERAM_LINE_SHIFT;
+  uint8_t slot = line & (SERAM_LINES - 1);
+  uint16_t pos = SERAM_CACHE_OFFSET + (slot << SERAM_LINE_SHIFT);
+
+  if (seRamTag[slot] != line) {
+    uint8_t old = seRamTag[slot];
+    // write back the evicted line
+    if (old != 0xFF && (seRamDirty & (1 << slot))) {
+      seRamWriteBlock(SERAM_MAP_ADDR + ((uint16_t) old << SERAM_LINE_SHIFT), fusemap + pos, SERAM_LINE);
+      seRamLoaded |= (1UL << old);
+    }
+    if (seRamLoaded & (1UL << line)) {
+      seRamReadBlock(SERAM_MAP_ADDR + ((uint16_t) line << SERAM_LINE_SHIFT), fusemap + pos, SERAM_LINE);
+    } else {
+      memset(fusemap + pos, 0, SERAM_LINE);
+    }
+    seRamTag[slot] = line;
+    seRamDirty &= ~(1 << slot);
+  }
+  if (write) {
+    seRamDirty |= (1 << slot);
+  }
+  return pos + (bytePos & (SERAM_LINE - 1));
+}
+
+// reads a fusemap byte without loading its line into the cache
+static uint8_t seRamMapPeek(uint16_t bytePos) {
+  uint8_t line = bytePos >> SERAM_LINE_SHIFT;
+  uint8_t slot = line & (SERAM_LINES - 1);
+
+  if (seRamTag[slot] == line) {
+    return fusemap[SERAM_CACHE_OFFSET + (slot << SERAM_LINE_SHIFT) + (bytePos & (SERAM_LINE - 1))];
+  }
+  if (seRamLoaded & (1UL << line)) {
+    return seRamRead(SERAM_MAP_ADDR + bytePos);
+  }
+  return 0;
 }
 
-#endif /* RAM_BIG */
+// writes the modified lines to the serial RAM, the cache stays valid
+static void seRamMapFlush(void) {
+  uint8_t i;
+  for (i = 0; i < SERAM_LINES; i++) {
+    if (seRamDirty & (1 << i)) {
+      seRamWriteBlock(SERAM_MAP_ADDR + ((uint16_t) seRamTag[i] << SERAM_LINE_SHIFT), fusemap + SERAM_CACHE_OFFSET + (i << SERAM_LINE_SHIFT), SERAM_LINE);
+      seRamLoaded |= (1UL << seRamTag[i]);
+    }
+  }
+  seRamDirty = 0;
+}
+
+// returns 1 if the fusemap is kept in the serial RAM
+// the fusemap is kept when it is already in use and clearMap is 0
+static char seRamMapInit(char clearMap) {
+  if (!seRamPresent) {
+    return 0;
+  }
+  if (clearMap || !seRamMapStat) {
+    seRamMapInvalidate();
+    seRamLoaded = 0;
+  }
+  seRamMapStat = 1;
+  return 1;
+}
+
+static inline void seRamMapDisable(void) {
+  seRamMapStat = 0;
+}
+
+#else /* ! USE_SERAM_FUSEMAP */
+
+#define seRamMapStat 0
+#define seRamMapInit(X) 0
+#define seRamMapDisable()
+#define seRamMapFlush()
+#define seRamMapInvalidate()
+#define seRamMapPos(P, W) 0
+#define seRamMapPeek(P) 0
+#endif /* USE_SERAM_FUSEMAP */
 
 #endif /*_AFTB_SERAM_*/
\ No newline at end of file
@@ -12,7 +12,17 @@
  *
  *  Sparse fusemap supports:
  *  - random reads and writes
- *  - a simple cache to speed up index look-ups.
+ *  - constant time index look-ups: the number of stored groups
+ *    before every 8 fuseType bytes is kept in fuseGroupCount array,
+ *    the stored groups within a fuseType byte are counted by bit tricks.
+ *  - amortised insertion: the fusemap array is a gap buffer. The groups
+ *    stored before the gap are at the start of the array, the groups
+ *    after the gap are at the end of the array. A new group is inserted
+ *    at the gap, so only the bytes between the old and the new gap
+ *    position are moved. Sequential writes (upload) or writes ordered
+ *    within a fuse row (GAL read) move each byte a few times only.
+ *  - incremental compaction: when a write moves to another group, the
+ *    previously written group is removed if all its bits are 1.
  */
 
 #ifdef USE_SPARSE_FUSEMAP
@@ -21,189 +31,166 @@
 #define COMPACT_STAT 0
 
 #define SPFUSES 128
+#define SPCOUNT_SHIFT 3 // fuseGroupCount entry per 8 fuseType bytes
 unsigned char fuseType[SPFUSES]; //sparse fuses index
+uint16_t fuseGroupCount[SPFUSES >> SPCOUNT_SHIFT]; // number of stored groups before the fuseType bytes
+
+// the gap buffer capacity in bytes: whole groups only
+#define SPARSE_BYTES (MAXFUSES & ~3)
 
 uint16_t sparseFusemapStat = 0; //bit 15: use sparse fusemaps, bits 0-11 : sparse fusemap size in bytes
-uint8_t  sparseCompactCounter = 0;
-uint16_t sparseCacheBitPos = 0;
-uint16_t sparseCacheOffset = 0;
-uint16_t  sparseCacheHit = 0;
-uint8_t  sparseCacheIndex = 0;
+uint16_t sparseGapPos = 0; // logical byte position of the gap
+uint16_t sparseLastGroup = 0xFFFF; // index of the last written stored group
+uint16_t sparseLastPos = 0; // logical byte position of the last written stored group
+uint8_t sparseOverflow = 0; // a group was refused: the fusemap array is full
 
 #if COMPACT_STAT
-uint8_t sparseCompactRun = 0;
-uint8_t sparseCompactAct = 0;
+uint16_t sparseCompactAct = 0;
 #endif
 
 
-// reverse search of the fuse group index based on the byte position in the sparse array
-// returns the group index
-static uint16_t getFuseGroupIndex(uint16_t fuseOffsetBytePos) {
-  uint16_t groupPos = 0;
-  uint16_t i = 0;
-  uint16_t fuseOffset = 0;
+// returns the number of stored groups (type 1) in a fuseType byte
+static inline uint8_t countStoredGroups(uint8_t rec) {
+  rec = rec & ~(rec >> 1) & 0b01010101; // bit 0 of each type 1 record
+  rec = (rec & 0b00110011) + ((rec >> 2) & 0b00110011);
+  return (rec & 0x0F) + (rec >> 4);
+}
 
-  //calculate fusemap offset
-  while (1) {
-    uint8_t rec = fuseType[i];
-    // speed optimised special case: all 8 bits are 0 (4 * 32 bits)
-    if (rec == 0) {
-        groupPos += 4; //4 groups in the byte
-    } else {
-      uint8_t j = 0;
-      //4 types per byte
-      while (j < 4) {
-        if ((rec & 0b11) == 1) { // type 0 & 3 - no byte stored in fusemap
-          if (fuseOffset == fuseOffsetBytePos) {
-              return groupPos;
-          }
-          fuseOffset += 4; // 32 bits in the group, fuse byte offset advances by 4 bytes
-        }
-        groupPos++; //check next group
-        rec >>= 2;
-        j++;
-      }
-    }
-    i++; //next byte from the fuseTypes
+// adds 'delta' to the stored group counts after the group
+static void updateGroupCount(uint16_t group, int8_t delta) {
+  uint8_t k;
+  for (k = (group >> (2 + SPCOUNT_SHIFT)) + 1; k < (SPFUSES >> SPCOUNT_SHIFT); k++) {
+    fuseGroupCount[k] += delta;
   }
 }
 
+// recalculates the stored group counts from the fuseType array
+static void rebuildGroupCount(void) {
+  uint16_t count = 0;
+  uint8_t i;
+  for (i = 0; i < SPFUSES; i++) {
+    if ((i & ((1 << SPCOUNT_SHIFT) - 1)) == 0) {
+      fuseGroupCount[i >> SPCOUNT_SHIFT] = count;
+    }
+    count += countStoredGroups(fuseType[i]);
+  }
+}
 
 // get position of the fuse bit in the sparse array
 static uint16_t getFusePositionAndType(uint16_t bitPos) {
-  uint16_t counter = 0;
-  uint8_t i = 0;
-  uint8_t type;
-  uint16_t fuseOffset = (bitPos & 0b11000)  >> 3; //set odd / even byte of the fuse offset
+  uint16_t group = bitPos >> 5; // 32 bits in the group
+  uint8_t i = group >> 2;       // 4 fuse types per byte
+  uint8_t k = i & ~((1 << SPCOUNT_SHIFT) - 1);
+  uint16_t count = fuseGroupCount[i >> SPCOUNT_SHIFT];
+  uint8_t shift = (group & 0b11) << 1;
+  uint8_t rec = fuseType[i];
+  uint16_t fuseOffset;
 
-  if (bitPos <= sparseCacheBitPos) {
-    sparseCacheBitPos = 0;
-    sparseCacheOffset = 0;
-    sparseCacheIndex = 0;
-  } else {
-    counter = sparseCacheBitPos;
-    fuseOffset += sparseCacheOffset & 0xFFC;
-    i = sparseCacheIndex;
-    sparseCacheHit++;
+  // stored groups before the fuseType byte
+  while (k < i) {
+    count += countStoredGroups(fuseType[k++]);
   }
+  // stored groups before the group within the byte
+  count += countStoredGroups(rec & ((1 << shift) - 1));
 
-  //calculate fusemap offset
-  while (1) {
-    uint8_t rec = fuseType[i];
-    // speed optimised special case: all 8 bits are 0 or all are 1 (4 * 32 bits)
-    if (rec == 0 || rec == 0xFF) {
-        counter += 128;
-        if (counter > bitPos) {
-          return (fuseOffset << 2) | (rec & 0b11); // type is 0 or 3
-        }
-        sparseCacheBitPos = counter;
-        sparseCacheOffset = fuseOffset;
-        sparseCacheIndex = i + 1;
-    }
-    else {
-      uint8_t j = 0;
-      //4 fuse types per byte
-      while (j < 4) {
-        counter += 32;
-        type = rec & 0b11;
-        if (counter > bitPos) {
-          return (fuseOffset << 2) | type;
-        }
-        if (type == 1) { // type 0 & 3 - no byte stored in fusemap
-          fuseOffset += 4;
-        }
-        rec >>= 2;
-        j++;
-      }
-    }
-    i++; //next byte from the fuseTypes
+  fuseOffset = (count << 2) + ((bitPos & 0b11000) >> 3); //odd / even byte of the fuse offset
+  return (fuseOffset << 2) | ((rec >> shift) & 0b11);
+}
+
+// converts the logical byte position to the position in the fusemap array
+static inline uint16_t sparsePhysPos(uint16_t pos) {
+  if (pos >= sparseGapPos) {
+    pos += SPARSE_BYTES - (sparseFusemapStat & 0x7FF);
   }
+  return pos;
 }
 
-static void insertFuseGroup(uint16_t dataPos, uint16_t bitPos) {
+// moves the gap to the logical byte position
+static void sparseMoveGap(uint16_t pos) {
+  uint16_t gap = SPARSE_BYTES - (sparseFusemapStat & 0x7FF);
+  if (pos < sparseGapPos) {
+    memmove(fusemap + pos + gap, fusemap + pos, sparseGapPos - pos);
+  } else if (pos > sparseGapPos) {
+    memmove(fusemap + sparseGapPos, fusemap + sparseGapPos + gap, pos - sparseGapPos);
+  }
+  sparseGapPos = pos;
+}
+
+// returns 0 and sets sparseOverflow if the fusemap array has no room for the group
+static char insertFuseGroup(uint16_t dataPos, uint16_t bitPos) {
   int16_t i = bitPos >> 5; //group index
-  uint16_t totalFuseBytes = sparseFusemapStat & 0x7FF; // max is 2048 bytes
+  if ((sparseFusemapStat & 0x7FF) + 4 > SPARSE_BYTES) {
+    sparseOverflow = 1;
+    return 0;
+  }
   fuseType[i >> 2] |= (1 << ((i & 0b11) << 1)); // set type 1 at the fuse group record
+  updateGroupCount(i, 1);
 
-  //shift all data in the fuse map  starting at data pos by 4 bytes (32 bits)
-  if (dataPos < totalFuseBytes) {
-    for (i =  totalFuseBytes - 1; i >= dataPos; i--) {
-      fusemap[i + 4] = fusemap[i];
-    }
-  }
-  sparseFusemapStat = totalFuseBytes + 4; // we can ignore the sparse bit
-  //clean the emptied fusemap data
+  // the group takes the first 4 bytes of the gap
+  sparseMoveGap(dataPos);
+  sparseGapPos += 4;
+  sparseFusemapStat += 4;
+  //clean the fusemap data of the group
   fusemap[dataPos++] = 0;
   fusemap[dataPos++] = 0;
   fusemap[dataPos++] = 0;
   fusemap[dataPos] = 0;
+  return 1;
 }
 
-
-static void sparseCompactFuseMap(void) {
-  uint16_t i, j;
-  uint16_t total = (sparseFusemapStat & 0x7FF) >> 2; // max is 2048 bytes, and convert to the group index
-  uint32_t* fuses = (uint32_t*) fusemap;
-
-  if (total < 2) {
-    return;
-  }
-
+// removes the stored group (with all bits 1) from the fusemap array, the bytes are returned to the gap
+static void removeFuseGroup(uint16_t dataPos, uint16_t group) {
+  sparseMoveGap(dataPos + 4);
+  sparseGapPos -= 4;
+  sparseFusemapStat -= 4; // fuse map total size reduced by 4 bytes
+  fuseType[group >> 2] |= (3 << ((group & 0b11) << 1)); //set type 3 at the fuse group record
+  updateGroupCount(group, -1);
 #if COMPACT_STAT
-  sparseCompactRun++; //statistics
+  sparseCompactAct++; //statistics
 #endif
+}
 
-
-  i = total - 1;
-  while(i) {
-    // remove 4 fusemap bytes at a position when the bits are all 1's
-    if (fuses[i] == 0xFFFFFFFF) {
-      if (i < total - 1) {
-        uint16_t fuseGroup = getFuseGroupIndex(i << 2); //ensure the int32 index is converted to int8/byte index
-#if COMPACT_STAT
-        sparseCompactAct++; //statistics
-#endif
-        /// shift the fuses by 4 bytes to the left
-        for (j = i; j < total - 1 ; j++) {
-          fuses[j] = fuses[j + 1];
-        }
-        total--;
-        fuseType[fuseGroup >> 2] |= (3 << ((fuseGroup & 0b11) << 1)); //set type 3 at the fuse group record
-        sparseFusemapStat -= 4; // fuse map total size reduced by 4 bytes
-      }
-    }
-    i--;
+// removes the last written group if all its bits are 1
+static void sparseCompactLastGroup(void) {
+  uint16_t pos;
+  if (sparseLastGroup == 0xFFFF) {
+    return;
   }
-  //destory cache
-  sparseCacheBitPos = 0;
-  sparseCacheOffset = 0;
-  sparseCacheIndex = 0;
-#if COMPACT_STAT
-  Serial.print(F("sp comp:"));
-  Serial.print(sparseCompactRun, DEC);
-  Serial.print(F(" total:"));
-  Serial.println(sparseFusemapStat & 0x7FF, DEC);
-
-#endif  
+  pos = sparsePhysPos(sparseLastPos);
+  if ((fusemap[pos] & fusemap[pos + 1] & fusemap[pos + 2] & fusemap[pos + 3]) == 0xFF) {
+    removeFuseGroup(sparseLastPos, sparseLastGroup);
+  }
+  sparseLastGroup = 0xFFFF;
 }
 
+// returns the byte position of the fuse bit (the group is inserted if needed)
+// or 0xFFFF if the group has all bits 1 and there is nothing to write, or there is no room for the group
 static inline uint16_t sparseSetFuseBit(uint16_t bitPos) {
     uint8_t type;
     uint16_t pos;
+    uint16_t group = bitPos >> 5;
 
-    //try to reduce the size of the fuse map by finding and removing blocks with all 1's
-    sparseCompactCounter ++;
-    if (sparseCompactCounter == 255) {
-      sparseCompactFuseMap();
+    //the previous group is not written anymore: remove it if all its bits are 1
+    if (group != sparseLastGroup) {
+      sparseCompactLastGroup();
     }
 
     pos = getFusePositionAndType(bitPos);
     type = pos & 0b11;
+    if (type == 3) { // the group was compacted: all bits are already set
+      return 0xFFFF;
+    }
     pos >>= 2; //trim the type to get the byte position in fuse map
+    sparseLastGroup = group;
+    sparseLastPos = pos & 0x7FC;
     if (type == 0) { //we need to write the bit into a group that has all bits 0 so far
-      insertFuseGroup(pos & 0x7FC, bitPos);
+      if (!insertFuseGroup(sparseLastPos, bitPos)) {
+        sparseLastGroup = 0xFFFF;
+        return 0xFFFF;
+      }
+      return pos; // the gap is after the group: the position is not shifted
     }
-    return pos;
+    return sparsePhysPos(pos);
 }
 
 static inline uint16_t sparseGetFuseBit(uint16_t bitPos) {
@@ -218,42 +205,67 @@ static inline uint16_t sparseGetFuseBit(uint16_t bitPos) {
       return 0xFF01;
     }
     pos >>= 2; //trim the type to get byte position in fuse map
-    return pos;
+    return sparsePhysPos(pos);
+}
+
+// gathers n fuse bits starting at bitPos, stride bits apart, into dst (packed LSB first).
+// The bit positions only grow, so the group records are walked once from the start.
+static void sparseGatherFuses(uint16_t bitPos, uint16_t stride, uint8_t n, uint8_t* dst) {
+  uint16_t groupEnd = 32; // first bit after the current group
+  uint16_t offset = 0;    // logical byte offset of the current group data
+  uint8_t i = 0;          // fuseType record index
+  uint8_t j = 0;          // group index within the record
+  uint8_t type = fuseType[0] & 0b11;
+  uint8_t k;
+
+  for (k = 0; k < n; k++, bitPos += stride) {
+    // advance to the group of the fuse
+    while (bitPos >= groupEnd) {
+      if (type == 1) { // type 0 & 3 - no byte stored in fusemap
+        offset += 4;
+      }
+      groupEnd += 32;
+      if (++j == 4) {
+        j = 0;
+        i++;
+      }
+      type = (fuseType[i] >> (j << 1)) & 0b11;
+    }
+    if (type == 3 || (type == 1 && ((fusemap[sparsePhysPos(offset) + ((bitPos >> 3) & 0b11)] >> (bitPos & 7)) & 1))) {
+      dst[k >> 3] |= (1 << (k & 7));
+    }
+  }
 }
 
 static void sparsePrintStat() {
     Serial.print(F("sp bytes="));
     Serial.println(sparseFusemapStat & 0x7FF, DEC);
-    Serial.print(F("c_hit="));
-    Serial.println(sparseCacheHit, DEC);
 #if COMPACT_STAT
-    Serial.print(F("compact run="));
-    Serial.print(sparseCompactRun, DEC);
-    Serial.print(F(" cnt="));
+    Serial.print(F("compact cnt="));
     Serial.println(sparseCompactAct, DEC);
 #endif
 }
 
+// the stored groups are kept when the sparse fusemap is already in use and clearArray is 0
 static void sparseInit(char clearArray) {
-  if (clearArray) {
+  if (clearArray || !sparseFusemapStat) {
     uint8_t i;
     for (i = 0; i < SPFUSES; i++) {
       fuseType[i] = 0;
     }
-
-  }
-  sparseFusemapStat = (1 << 15);
-  sparseCompactCounter = 0;
-  sparseCacheBitPos = 0;
-  sparseCacheOffset = 0;
-  sparseCacheIndex = 0;
+    sparseFusemapStat = (1 << 15);
+    sparseGapPos = 0;
+    sparseLastGroup = 0xFFFF;
+    sparseOverflow = 0;
 #if COMPACT_STAT
-  sparseCompactRun = 0;
-  sparseCompactAct = 0;
+    sparseCompactAct = 0;
 #endif
+  }
+  rebuildGroupCount();
 }
 static inline void sparseDisable(void) {
     sparseFusemapStat = 0;
+    sparseOverflow = 0;
 }
 #else /* ! USE_SPARSE_FUSEMAP */
 
@@ -261,6 +273,8 @@ static inline void sparseDisable(void) {
 #define sparseInit(X)
 #define sparseGetFuseBit(X) 0
 #define sparseSetFuseBit(X) 0
+#define sparseGatherFuses(P,S,N,D)
 #define sparsePrintStat()
 #define sparseFusemapStat 0
+#define sparseOverflow 0
 #endif
@@ -0,0 +1,108 @@
+#ifndef __AFTB_SPI_H__
+#define __AFTB_SPI_H__
+
+/*
+ * Serial bus functions for Afterburner GAL project.
+ *
+ *  The shift register, the MCP4131 digi-pot and the serial RAM share
+ *  the clock and data lines of the new board design. Each device has
+ *  its own select. The bus pins are neither on the hardware SPI nor on
+ *  the USART of the UNO, therefore the bits are shifted by software:
+ *  on AVR MCUs by direct access to the port registers (resolved once
+ *  by spiInit()), on other MCUs by digitalWrite() / digitalRead().
+ *
+ *  SPI mode 0, MSB first: the data bit is set before the rising edge
+ *  of the clock and read after the rising edge.
+ */
+
+//set default pins
+#ifndef SPI_CLK
+#define SPI_CLK  A4
+#endif
+
+#ifndef SPI_DAT
+#define SPI_DAT  A5
+#endif
+
+#ifdef __AVR__
+static volatile uint8_t* spiClkPort;
+static volatile uint8_t* spiDatPort;
+static volatile uint8_t* spiDatInPort;
+static uint8_t spiClkMask;
+static uint8_t spiDatMask;
+#endif
+
+static void spiInit(void) {
+    pinMode(SPI_CLK, OUTPUT);
+    pinMode(SPI_DAT, OUTPUT);
+#ifdef __AVR__
+    spiClkPort = portOutputRegister(digitalPinToPort(SPI_CLK));
+    spiClkMask = digitalPinToBitMask(SPI_CLK);
+    spiDatPort = portOutputRegister(digitalPinToPort(SPI_DAT));
+    spiDatInPort = portInputRegister(digitalPinToPort(SPI_DAT));
+    spiDatMask = digitalPinToBitMask(SPI_DAT);
+#endif
+}
+
+static inline void spiClk(uint8_t on) {
+#ifdef __AVR__
+    if (on) {
+        *spiClkPort |= spiClkMask;
+    } else {
+        *spiClkPort &= ~spiClkMask;
+    }
+#else
+    digitalWrite(SPI_CLK, on ? 1 : 0);
+#endif
+}
+
+static inline void spiDat(uint8_t on) {
+#ifdef __AVR__
+    if (on) {
+        *spiDatPort |= spiDatMask;
+    } else {
+        *spiDatPort &= ~spiDatMask;
+    }
+#else
+    digitalWrite(SPI_DAT, on ? 1 : 0);
+#endif
+}
+
+static inline uint8_t spiDatGet(void) {
+#ifdef __AVR__
+    return (*spiDatInPort & spiDatMask) ? 1 : 0;
+#else
+    return digitalRead(SPI_DAT) ? 1 : 0;
+#endif
+}
+
+// writes 'bitLen' bits of data (MSB first), the clock is left low
+static void spiWrite(uint16_t data, uint8_t bitLen) {
+    uint16_t mask = (1 << (bitLen - 1));
+
+    spiClk(0);
+    while (bitLen) {
+        bitLen--;
+        spiDat(data & mask);
+        spiClk(1);
+        data <<= 1;
+        spiClk(0);
+    }
+}
+
+// reads 8 bits (MSB first), the data pin must be switched to input by the caller
+static uint8_t spiRead(void) {
+    uint8_t bitLen = 8;
+    uint8_t result = 0;
+
+    while (bitLen) {
+        result <<= 1;
+        spiClk(1);
+        result |= spiDatGet();
+        bitLen--;
+        spiClk(0);
+    }
+    return result;
+}
+
+#endif /* __AFTB_SPI_H__ */
@@ -12,8 +12,8 @@
 
 // ensure mcp4131 pot uses the right pins
 #define POT_CS   A3
-#define POT_CLK  A4
-#define POT_DAT  A5
+#define SPI_CLK  A4
+#define SPI_DAT  A5
 #define VPP      A0
 
 #if CONFIG_IDF_TARGET_ESP32S2 == 1
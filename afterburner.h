@@ -126,6 +126,16 @@
 #define COMMAND_CALIBRATE_VPP 'b'
 #define COMMAND_CALIBRATION_OFFSET 'B'
 #define COMMAND_JTAG_PLAYER 'j'
+#define COMMAND_STREAM_WRITE 'W'
+#define COMMAND_STREAM_VERIFY 'V'
+#define COMMAND_READ_FUSES_BINARY 'R'
+#define COMMAND_CRC_FUSES 'C'
+#define COMMAND_REPAIR_ROWS 'x'
+#define COMMAND_BLANK_CHECK 'k'
+#define COMMAND_INVALIDATE_PES 'i'
+#define COMMAND_COMPOUND 'a'
+#define COMMAND_DETECT_TYPE 'T'
+#define COMMAND_FUSE_SLOT 'S'
 
 #define READGAL 0
 #define VERIFYGAL 1
@@ -148,6 +158,18 @@
 // Keep the power-down feature enabled for ATF C GALs
 #define FLAG_BIT_APD (1 << 2)
 
+// fuse rows are stored in programming (row-major) order instead of JEDEC order
+#define FLAG_BIT_ROW_ORDER (1 << 3)
+
+// fuse rows are received from the serial line while the GAL is being programmed
+#define FLAG_BIT_STREAM (1 << 4)
+
+// fuses read from the GAL are added to CRC32 instead of being stored in the fusemap
+#define FLAG_BIT_CRC (1 << 5)
+
+// write only the fuse rows that failed the last verification
+#define FLAG_BIT_REPAIR (1 << 6)
+
 // contents of pes[3]
 // Atmel PES is text string eg. 1B8V61F1 or 3Z01V22F1
 //                                 ^           ^
@@ -236,6 +258,8 @@ typedef enum {
 //extra space added for sparse fusemap (just enough to fit erased ATF750C)
 #define MAXFUSES 1332
 #define USE_SPARSE_FUSEMAP
+// ATF750C fusemap is kept in the serial RAM when present (sparse fusemap otherwise)
+#define USE_SERAM_FUSEMAP
 #endif
 
 //   UES     user electronic signature
@@ -172,31 +172,97 @@ GALTYPE gal __attribute__ ((section (".noinit"))); //the gal device index pointi
 static short erasetime = 100, progtime = 100;
 static uint8_t vpp = 0;
 
+// timing profile, all times in microseconds. The defaults are set by the 'g' command and when
+// the GAL type changes, the PC program may override the fields by the '#s' upload command.
+typedef struct {
+  uint16_t clkHigh;   // extra SCLK high time of a sent bit
+  uint16_t rowSettle; // delay after a fuse row is read (V10 types and ATF750C)
+  uint16_t rowStrobe; // STB pulse of the row read strobe
+  uint32_t prog;      // programming pulse, 0: taken from PES (progtime)
+  uint32_t erase;     // erase pulse, 0: taken from PES (erasetime)
+} timing_t;
+
+static timing_t timing;
+
 char echoEnabled;
 unsigned char pes[12];
 char line[32];
 short lineIndex;
 char endOfLine;
 char mapUploaded;
+char pesCached; // PES was read and the type check passed, valid until invalidated
+char powerSession; // keep the GAL powered between turnOn() / turnOff() calls
+char powered;
 char isUploading;
 char uploadError;
 unsigned char fusemap[MAXFUSES];
+unsigned short fuseSum; // JEDEC checksum of the fuses set by setFuseBit() and setFuseByte()
+unsigned short fuseSumEnd; // fuse position after the last fuse set
 unsigned char flagBits;
 char varVppExists;
 uint8_t lastShiftRegVal = 0;
 
 static void setFuseBit(unsigned short bitPos);
+static void setFuseByte(unsigned short bitPos, unsigned char val);
 static unsigned short checkSum(unsigned short n);
 static char checkGalTypeViaPes(void);
+static void setupFastIo(void);
 static void turnOff(void);
 static void printFormatedNumberHex2(unsigned char num) ;
 
+static void setTimingDefaults(void) {
+  // For some reason ATF20V8B needs a slower clock
+  timing.clkHigh = (gal == ATF20V8B) ? 1000 : 0;
+  timing.rowSettle = 1000;
+  timing.rowStrobe = 2000;
+  timing.prog = 0;
+  timing.erase = 0;
+}
+
+// sets a field of the timing profile, returns 0 if the field is unknown
+static char setTiming(char field, uint32_t t) {
+  switch (field) {
+    case 'c': timing.clkHigh = t; break;
+    case 'r': timing.rowSettle = t; break;
+    case 's': timing.rowStrobe = t; break;
+    case 'p': timing.prog = t; break;
+    case 'e': timing.erase = t; break;
+    default: return 0;
+  }
+  return 1;
+}
+
+// programming and erase pulse lengths in microseconds
+static uint32_t progUs(void) {
+  return timing.prog ? timing.prog : progtime * 1000UL;
+}
+
+static uint32_t eraseUs(void) {
+  return timing.erase ? timing.erase : erasetime * 1000UL;
+}
+
+// waits for some microseconds, longer delays than delayMicroseconds() handles are split
+static void delayUs(uint32_t usec)
+{
+  if (usec >= 16000) {
+    delay(usec / 1000);
+    usec %= 1000;
+  }
+  if (usec) {
+    delayMicroseconds(usec);
+  }
+}
+
 #include "aftb_vpp.h"
 #include "aftb_sparse.h"
+// serial RAM transfers latch the shift register: keep its outputs
+#define SERAM_SHR_VALUE lastShiftRegVal
 #include "aftb_seram.h"
 
 // share fusemap buffer with jtag
 #define XSVF_HEAP fusemap
+// XSVF streams can be played from the serial RAM
+#define XSVF_CACHE_READ(ADDR, BUF, LEN) seRamReadBlock((ADDR), (BUF), (LEN))
 #include "jtag_xsvf_player.h"
 
 // print some help on the serial console
@@ -209,6 +275,11 @@ void printHelp(char full) {
 #ifdef RAM_BIG
     Serial.println(F(" RAM-BIG "));
 #endif
+  // protocol extensions supported by this firmware
+  Serial.println(F(" rowOrder streamWrite streamVerify binaryRead crc32 repair blankCheck compound detect timing xsvfCredit "));
+  if (seRamPresent) {
+    Serial.println(F(" xsvfCache fuseSlots "));
+  }
 
   if (!full) {
     Serial.println(F("type 'h' for help"));
@@ -218,11 +289,26 @@ void printHelp(char full) {
   Serial.println(F("  h - print help"));
   Serial.println(F("  e - toggle echo")); 
   Serial.println(F("  p - read & print PES"));
-  Serial.println(F("  r - read & print fuses"));  
+  Serial.println(F("  T - detect GAL type"));
+  Serial.println(F("  r - read & print fuses"));
+  Serial.println(F("  R - read fuses (binary)"));
+  Serial.println(F("  C - read fuses CRC32"));  
   Serial.println(F("  u - upload fuses"));
   Serial.println(F("  w - write uploaded fuses"));
+  Serial.println(F("  W - write streamed fuses"));
   Serial.println(F("  v - verify fuses"));
+  Serial.println(F("  V - verify streamed fuses"));
+  Serial.println(F("  x - re-write rows failed to verify"));
   Serial.println(F("  c - erase chip"));
+  Serial.println(F("  k - blank check"));
+  Serial.println(F("  i - forget cached PES"));
+  Serial.println(F("  a<ops> - run c~wvs ops at once"));
+  if (seRamPresent) {
+    Serial.println(F("  Sl - list fuse map slots"));
+    Serial.println(F("  Ss<n> <hash> - store fuses to slot"));
+    Serial.println(F("  Sa<n> - select slot as uploaded fuses"));
+    Serial.println(F("  Se<n> - evict slot"));
+  }
   Serial.println(F("  t - test & set VPP"));
   Serial.println(F("  b - calibrate VPP"));
   Serial.println(F("  m - measure VPP"));
@@ -358,30 +444,27 @@ static void setupGpios(uint8_t pm) {
   }
 }
 
-#define SHR_SET_BIT(X) digitalWrite(PIN_SHR_CLK, 0); \
-                        digitalWrite(PIN_SHR_DAT, (X) ? HIGH : LOW); \
-                        digitalWrite(PIN_SHR_CLK, 1)
-                        
 static void setShiftReg(uint8_t val) {
   lastShiftRegVal = val;
   //assume CS is high
 
-  //ensure CLK is high (might be set low by other SPI devices)
-  digitalWrite(PIN_SHR_CLK, 1);
-  
+  //ensure CLK is low (might be left high by other SPI devices)
+  spiClk(0);
+
   // set CS low
   digitalWrite(PIN_SHR_CS, 0);
-  SHR_SET_BIT(val & 0b10000000);
-  SHR_SET_BIT(val & 0b1000000);
-  SHR_SET_BIT(val & 0b100000);
-  SHR_SET_BIT(val & 0b10000);
-  SHR_SET_BIT(val & 0b1000);
-  SHR_SET_BIT(val & 0b100);
-  SHR_SET_BIT(val & 0b10);
-  SHR_SET_BIT(val & 0b1);
+  spiWrite(val, 8); // the shift register latches the bits on the rising clock edge
   digitalWrite(PIN_SHR_CS, 1);
 }
 
+// sets the shift register unless it already holds the value. Serial RAM transfers
+// keep the outputs: seRamBusReset() latches lastShiftRegVal again (SERAM_SHR_VALUE).
+static void updateShiftReg(uint8_t val) {
+  if (val != lastShiftRegVal) {
+    setShiftReg(val);
+  }
+}
+
 // setup the Arduino board
 void setup() {
 // initialize serial:
@@ -390,11 +473,14 @@ void setup() {
   endOfLine = 0;
   echoEnabled = 0;
   mapUploaded = 0;
+  pesCached = 0;
   lineIndex = 0;
   setFlagBit(FLAG_BIT_TYPE_CHECK, 1); //do type check
+  setTimingDefaults();
 
   //check & initialise variable voltage (old / new board design)
   varVppExists = varVppInit();
+  setupFastIo();
 
   // shift register
   pinMode(PIN_SHR_EN, OUTPUT);
@@ -414,6 +500,8 @@ void setup() {
     // set shift reg Chip select
     pinMode(PIN_SHR_CS, OUTPUT);
     digitalWrite(PIN_SHR_CS, 1); //unselect the POT's SPI bus
+    // start from a known state, later updates are skipped when the value does not change
+    setShiftReg(0);
 
     //setup serial RAM
     if (seRamInit()) {
@@ -427,9 +515,15 @@ void setup() {
 static void sparseSetup(char clearArray){
   // Note: Sparse fuse map is ignored on MCUs with big SRAM
   if (gal == ATF750C) {
-    sparseInit(clearArray);
+    if (seRamMapInit(clearArray)) {
+      // the whole fusemap fits the serial RAM
+      sparseDisable();
+    } else {
+      sparseInit(clearArray);
+    }
   } else {
     sparseDisable();
+    seRamMapDisable();
   }
 }
 
@@ -438,6 +532,18 @@ static void copyGalInfo(void) {
   memcpy_P(&galinfo, &galInfoList[gal], sizeof(galinfo_t));
 
   sparseSetup(0);
+  setupFastIo();
+}
+
+// clears the fuse-map and its running checksum
+static void clearFuseMap(void) {
+  unsigned short i;
+  for (i = 0; i < MAXFUSES; i++) {
+    fusemap[i] = 0;
+  }
+  sparseSetup(1);
+  fuseSum = 0;
+  fuseSumEnd = 0;
 }
 
 // read from serial line and discard the data
@@ -484,7 +590,7 @@ char handleTerminalCommands() {
       c = line[0];  
       if (!isUploading || c != '#') {
         // prevent 2 character commands from being flagged as invalid
-        if (!(c == COMMAND_SET_GAL_TYPE || c == COMMAND_CALIBRATION_OFFSET || c == COMMAND_JTAG_PLAYER)) {
+        if (!(c == COMMAND_SET_GAL_TYPE || c == COMMAND_CALIBRATION_OFFSET || c == COMMAND_JTAG_PLAYER || c == COMMAND_COMPOUND || c == COMMAND_FUSE_SLOT)) {
           c = COMMAND_UNKNOWN; 
         }
       }
@@ -562,12 +668,14 @@ unsigned short parse4hex(char i) {
 // t <gal index>: gal type index to the GALTYPEE enum
 // f <fuse index> <row>: row of fuse-map data starting on fuse bit index
 // c <checksum> : checksum of the whole fuse map
+// o : fuse rows follow in programming (row-major) order
+// s <field> <time> : timing profile field (c, r, s, p, e), time in us as 8 digit hex number
 // e : end ofthe upload transfer - returns to terminal
 
 void parseUploadLine() {
   switch (line[1]) {
     case 'e': {
-      if (uploadError) {
+      if (uploadError || sparseOverflow) {
         Serial.print(F("ER upload failed"));
       } else {
         Serial.print(F("OK upload finished"));
@@ -579,7 +687,11 @@ void parseUploadLine() {
     case 't': {
       short v = line[3] - '0';
       if (v > 0 && v < LAST_GAL_TYPE) {
-        gal = (GALTYPE) v;
+        if (gal != v) {
+          pesCached = 0;
+          gal = (GALTYPE) v;
+          setTimingDefaults();
+        }
         copyGalInfo();
         Serial.print(F("OK gal set: "));
         Serial.println((short) gal, DEC);
@@ -603,12 +715,20 @@ void parseUploadLine() {
       do {
         v = parse2hex(i);
         if (v >= 0) {
-          for (j = 0; j < 8; j++) {
-            // if fuse bit is set -> then change the fusemap
-            if (v & (1 << j)) {
-              setFuseBit(addr);
+          if ((addr & 7) == 0) {
+            // byte aligned address -> write the whole byte at once
+            if (v) {
+              setFuseByte(addr, v);
+            }
+            addr += 8;
+          } else {
+            for (j = 0; j < 8; j++) {
+              // if fuse bit is set -> then change the fusemap
+              if (v & (1 << j)) {
+                setFuseBit(addr);
+              }
+              addr++;
             }
-            addr++;
           }
           i += 2;
         }
@@ -640,6 +760,32 @@ void parseUploadLine() {
       }
     } break;
     
+    // fuse rows are uploaded in programming order: row by row, bit by bit.
+    // UES and CFG fuses keep their JEDEC positions.
+    case 'o': {
+      if (galinfo.pinout == PINOUT_600 || galinfo.pinout == PINOUT_UNKNOWN) {
+        uploadError = 1;
+        Serial.println(F("ER row order not supported"));
+      } else {
+        setFlagBit(FLAG_BIT_ROW_ORDER, 1);
+        Serial.println(F("OK row order"));
+      }
+    } break;
+
+    // timing profile
+    case 's': {
+      uint32_t t = parse4hex(5);
+      t <<= 16;
+      t |= parse4hex(9);
+      if (setTiming(line[3], t)) {
+        Serial.print(F("OK timing "));
+        Serial.println(t, DEC);
+      } else {
+        uploadError = 1;
+        Serial.println(F("ER unknown timing field"));
+      }
+    } break;
+
     // PES
     case 'p': {
       uint8_t i = 0;
@@ -746,16 +892,85 @@ static void setPV(char on) {
   }
 }
 
+// port registers and bit masks of the serial pins that are clocked for every fuse bit,
+// resolved by setupFastIo() when the GAL type changes. The port is NULL when the pin
+// is driven via the shift register or when the MCU is not an AVR.
+static volatile uint8_t* sdinPort;
+static volatile uint8_t* sclkPort;
+static volatile uint8_t* sdoutPort;
+static uint8_t sdinMask;
+static uint8_t sclkMask;
+static uint8_t sdoutMask;
+static uint8_t sdoutPin;
+
+// row shift kernels, picked by setupFastIo()
+static void sendRowGeneric(const unsigned char* src, unsigned char n, char skipLastClk);
+static void sendRowPort(const unsigned char* src, unsigned char n, char skipLastClk);
+static void receiveRowGeneric(unsigned char* dst, unsigned char n);
+static void receiveRowPort(unsigned char* dst, unsigned char n);
+static void sendRowShiftReg(const unsigned char* src, unsigned char n, char skipLastClk);
+static void receiveRowShiftReg(unsigned char* dst, unsigned char n);
+static void (*sendRow)(const unsigned char* src, unsigned char n, char skipLastClk);
+static void (*receiveRow)(unsigned char* dst, unsigned char n);
+
+static void setupFastIo(void) {
+  uint8_t sdin = PIN_SDIN;
+  uint8_t sclk = PIN_SCLK;
+  uint8_t sdout = PIN_SDOUT;
+
+  sdinPort = sclkPort = NULL;
+  if (varVppExists) {
+    const PINOUT p = galinfo.pinout;
+    sdin = (p == PINOUT_16V8) ? PIN_ZIF9 : PIN_ZIF11;
+    sclk = (p == PINOUT_16V8) ? PIN_ZIF8 : PIN_ZIF10;
+    sdout = PIN_ZIF16;
+    if (p == PINOUT_22V10 || p == PINOUT_600) {
+      sdout = PIN_ZIF14;
+    } else
+    if (p == PINOUT_20V8) {
+      sdout = PIN_ZIF15;
+    } else
+    if (p == PINOUT_18V10) {
+      sdout = PIN_ZIF9;
+      // SDIN and SCLK are on the shift register
+      sdin = sclk = 0xFF;
+    }
+  }
+  sdoutPin = sdout;
+#ifdef __AVR__
+  if (sdin != 0xFF) {
+    sdinPort = portOutputRegister(digitalPinToPort(sdin));
+    sdinMask = digitalPinToBitMask(sdin);
+    sclkPort = portOutputRegister(digitalPinToPort(sclk));
+    sclkMask = digitalPinToBitMask(sclk);
+  }
+  sdoutPort = portInputRegister(digitalPinToPort(sdout));
+  sdoutMask = digitalPinToBitMask(sdout);
+#else
+  sdoutPort = NULL;
+#endif
+
+  sendRow = sdinPort ? sendRowPort : sendRowGeneric;
+  receiveRow = sclkPort ? receiveRowPort : receiveRowGeneric;
+  if (sdin == 0xFF) {
+    sendRow = sendRowShiftReg;
+    receiveRow = receiveRowShiftReg;
+  }
+}
+
 static void setSDIN(char on) {
+  if (sdinPort) {
+    if (on) {
+      *sdinPort |= sdinMask;
+    } else {
+      *sdinPort &= ~sdinMask;
+    }
+    return;
+  }
   if (varVppExists) {
     const PINOUT p = galinfo.pinout;
     if (p == PINOUT_18V10) {
-      if (on) {
-        lastShiftRegVal |= PIN_ZIF7;
-      } else {
-        lastShiftRegVal &= ~PIN_ZIF7;
-      }
-      setShiftReg(lastShiftRegVal);
+      updateShiftReg(on ? (lastShiftRegVal | PIN_ZIF7) : (lastShiftRegVal & ~PIN_ZIF7));
     } else {
     const uint8_t pin = (p == PINOUT_16V8) ? PIN_ZIF9 : PIN_ZIF11;
     digitalWrite(pin, on ? 1:0);
@@ -766,15 +981,18 @@ static void setSDIN(char on) {
 }
 
 static void setSCLK(char on){
+  if (sclkPort) {
+    if (on) {
+      *sclkPort |= sclkMask;
+    } else {
+      *sclkPort &= ~sclkMask;
+    }
+    return;
+  }
   if (varVppExists) {
     const PINOUT p = galinfo.pinout;
     if (p == PINOUT_18V10) {
-      if (on) {
-        lastShiftRegVal |= PIN_ZIF6;
-      } else {
-        lastShiftRegVal &= ~PIN_ZIF6;
-      }
-      setShiftReg(lastShiftRegVal);
+      updateShiftReg(on ? (lastShiftRegVal | PIN_ZIF6) : (lastShiftRegVal & ~PIN_ZIF6));
     } else {
     uint8_t pin = (p == PINOUT_16V8) ? PIN_ZIF8 : PIN_ZIF10;
     digitalWrite(pin, on ? 1:0);
@@ -821,7 +1039,7 @@ static void setRow(char row)
       digitalWrite(PIN_ZIF8, (row & 0x10)); //RA4
       digitalWrite(PIN_ZIF9, (row & 0x20)); //RA5           
     }
-    setShiftReg(srval);
+    updateShiftReg(srval);
   } else {
     digitalWrite(PIN_RA0, (row & 0x1));
     digitalWrite(PIN_RA1, ((row & 0x2) ? 1:0));
@@ -835,28 +1053,21 @@ static void setRow(char row)
 // serial data out form the GAL chip -> received by Arduino
 static char getSDOUT(void)
 {
-  if (varVppExists) {
-    const PINOUT p = galinfo.pinout;
-    uint8_t pin = PIN_ZIF16;
-    
-    if (p == PINOUT_22V10 || p == PINOUT_600) {
-      pin = PIN_ZIF14;
-    } else
-    if (p == PINOUT_20V8) {
-      pin = PIN_ZIF15;
-    } else
-    if (p == PINOUT_18V10) {
-      pin = PIN_ZIF9;
-    }
-    return digitalRead(pin) != 0;
-  } else {
-    return digitalRead(PIN_SDOUT) != 0;
+  if (sdoutPort) {
+    return (*sdoutPort & sdoutMask) != 0;
   }
+  return digitalRead(sdoutPin) != 0;
 }
 
 // GAL finish sequence
 static void turnOff(void)
 {
+    // the next operation of the power session follows: keep VCC and VPP on
+    if (powerSession) {
+        setPV(0);
+        return;
+    }
+    powered = 0;
     delay(100);
     setPV(0);    // P/V- low
     setRow(0x3F);// RA0-5 high  
@@ -872,6 +1083,16 @@ static void turnOff(void)
 
 // GAL init sequence
 static void turnOn(char mode) {
+    // already powered in this power session: just reset the control pins
+    if (powerSession && powered) {
+        setPV(0);
+        setRow(0x3F);
+        setSDIN(1);
+        setSTB(1);
+        setSCLK(0);
+        return;
+    }
+    powered = 1;
     setupGpios(OUTPUT);
 
     if (mode == READPES) {
@@ -929,8 +1150,8 @@ static void sendBit(char bitValue, char skipClkLow = 0)
     setSDIN(bitValue);
     setSCLK(1);
     // For some reason ATF20V8B needs a slower clock
-    if (gal == ATF20V8B) {
-      delay(1);
+    if (timing.clkHigh) {
+      delayUs(timing.clkHigh);
     }
     if (!skipClkLow) {
         setSCLK(0);
@@ -946,6 +1167,129 @@ static void sendBits(short n, char bitValue)
     }
 }
 
+// Row shift kernels: shift n bits of a fuse row packed LSB first out to SDIN or in from SDOUT.
+// The port variants keep the registers and masks in local variables and clock the bits
+// without calling the pin helpers.
+static void sendRowGeneric(const unsigned char* src, unsigned char n, char skipLastClk)
+{
+    unsigned char bit;
+    for (bit = 0; bit < n; bit++) {
+        sendBit((src[bit >> 3] >> (bit & 7)) & 1, bit == n - 1 ? skipLastClk : 0);
+    }
+}
+
+static void sendRowPort(const unsigned char* src, unsigned char n, char skipLastClk)
+{
+    volatile uint8_t* const sdin = sdinPort;
+    volatile uint8_t* const sclk = sclkPort;
+    const uint8_t dMask = sdinMask;
+    const uint8_t cMask = sclkMask;
+    const uint16_t clkHigh = timing.clkHigh;
+    const unsigned char last = skipLastClk ? n - 1 : n;
+    unsigned char bit;
+    unsigned char v = 0;
+
+    for (bit = 0; bit < n; bit++) {
+        if ((bit & 7) == 0) {
+            v = *src++;
+        }
+        if (v & 1) {
+            *sdin |= dMask;
+        } else {
+            *sdin &= ~dMask;
+        }
+        v >>= 1;
+        *sclk |= cMask;
+        if (clkHigh) {
+            delayUs(clkHigh);
+        }
+        // ATF16V8C: the clock of the last bit stays high
+        if (bit != last) {
+            *sclk &= ~cMask;
+        }
+    }
+}
+
+static void receiveRowGeneric(unsigned char* dst, unsigned char n)
+{
+    unsigned char bit;
+    memset(dst, 0, (n + 7) >> 3);
+    for (bit = 0; bit < n; bit++) {
+        if (receiveBit()) {
+            dst[bit >> 3] |= (1 << (bit & 7));
+        }
+    }
+}
+
+static void receiveRowPort(unsigned char* dst, unsigned char n)
+{
+    volatile uint8_t* const sdout = sdoutPort;
+    volatile uint8_t* const sclk = sclkPort;
+    const uint8_t oMask = sdoutMask;
+    const uint8_t cMask = sclkMask;
+    unsigned char bit;
+    unsigned char v = 0;
+    unsigned char m = 1;
+
+    for (bit = 0; bit < n; bit++) {
+        if (*sdout & oMask) {
+            v |= m;
+        }
+        *sclk |= cMask;
+        *sclk &= ~cMask;
+        m <<= 1;
+        if (m == 0) {
+            *dst++ = v;
+            v = 0;
+            m = 1;
+        }
+    }
+    if (m != 1) {
+        *dst = v;
+    }
+}
+
+// The shift register variants (18V10 pinout of the new board, SDIN on ZIF7, SCLK on ZIF6)
+// send the data bit and both clock edges of a fuse as one sequence of shift register updates.
+// The data update is skipped when the bit does not change.
+static void sendRowShiftReg(const unsigned char* src, unsigned char n, char skipLastClk)
+{
+    unsigned char bit;
+    uint8_t v = lastShiftRegVal & ~(PIN_ZIF6 | PIN_ZIF7);
+
+    for (bit = 0; bit < n; bit++) {
+        if ((src[bit >> 3] >> (bit & 7)) & 1) {
+            v |= PIN_ZIF7;
+        } else {
+            v &= ~PIN_ZIF7;
+        }
+        updateShiftReg(v);
+        setShiftReg(v | PIN_ZIF6);
+        if (timing.clkHigh) {
+            delayUs(timing.clkHigh);
+        }
+        if (bit != n - 1 || !skipLastClk) {
+            setShiftReg(v);
+        }
+    }
+}
+
+static void receiveRowShiftReg(unsigned char* dst, unsigned char n)
+{
+    unsigned char bit;
+    const uint8_t v = lastShiftRegVal & ~PIN_ZIF6;
+
+    memset(dst, 0, (n + 7) >> 3);
+    updateShiftReg(v);
+    for (bit = 0; bit < n; bit++) {
+        if (getSDOUT()) {
+            dst[bit >> 3] |= (1 << (bit & 7));
+        }
+        setShiftReg(v | PIN_ZIF6);
+        setShiftReg(v);
+    }
+}
+
 // send row address bits to SDIN 
 // ATF22V10C MSb first, other 22V10 LSb first
 static void sendAddress(unsigned char n, unsigned char row)
@@ -974,11 +1318,11 @@ static void sendAddress(unsigned char n, unsigned char row)
   }
 }
 
-// pulse STB pin low for some milliseconds 
-static void strobe(unsigned short msec)
+// pulse STB pin low for some microseconds
+static void strobe(uint32_t usec)
 {
   setSTB(0);
-  delay(msec);
+  delayUs(usec);
   setSTB(1);
 }
 
@@ -997,7 +1341,7 @@ static void strobeRow(char row, char setBit = BIT_NONE)
       if (setBit) {
         sendBits(1, setBit - 1);
       }
-      strobe(2);           // pulse /STB for 2ms
+      strobe(timing.rowStrobe); // pulse /STB, 2ms by default
       break;
     case ATF750C:
       nBits = 7;
@@ -1023,7 +1367,7 @@ static void strobeRow(char row, char setBit = BIT_NONE)
       sendBit(1);
       sendAddress(7, row);
       sendBits(16, 0);
-      strobe(2);           // pulse /STB for 2ms
+      strobe(timing.rowStrobe); // pulse /STB, 2ms by default
       break;
    }
 }
@@ -1113,7 +1457,7 @@ static void writePes(void) {
       }
       break;
   }
-  strobe(progtime);
+  strobe(progUs());
   turnOff();
 }
 
@@ -1292,12 +1636,50 @@ void printPes(char type) {
 // expects that the fusemap was cleared (set to zero) beforehand
 static void setFuseBit(unsigned short bitPos) {
     uint16_t pos;
+    unsigned char mask = 1 << (bitPos & 7);
     if (sparseFusemapStat) {
       pos = sparseSetFuseBit(bitPos);
+      if (pos == 0xFFFF) {
+        return;
+      }
+    } else if (seRamMapStat) {
+      pos = seRamMapPos(bitPos >> 3, 1);
     } else {
       pos = bitPos >> 3; //divide the bit position by 8 to get the byte position
     }
-    fusemap[pos] |= (1 << (bitPos & 7));
+    // the checksum is a sum of the fuse bytes: a new bit adds its weight within the byte
+    if (!(fusemap[pos] & mask)) {
+      fusemap[pos] |= mask;
+      fuseSum += mask;
+      if (bitPos >= fuseSumEnd) {
+        fuseSumEnd = bitPos + 1;
+      }
+    }
+}
+
+// sets 8 fuse bits at once, the bit position must be a multiple of 8
+// expects that the fusemap was cleared (set to zero) beforehand
+static void setFuseByte(unsigned short bitPos, unsigned char val) {
+    uint16_t pos;
+    if (sparseFusemapStat) {
+      // one look-up (and group insertion) per byte instead of per bit
+      pos = sparseSetFuseBit(bitPos);
+      if (pos == 0xFFFF) {
+        return;
+      }
+    } else if (seRamMapStat) {
+      pos = seRamMapPos(bitPos >> 3, 1);
+    } else {
+      pos = bitPos >> 3;
+    }
+    val &= ~fusemap[pos];
+    if (val) {
+      fusemap[pos] |= val;
+      fuseSum += val;
+      if (bitPos + 8 > fuseSumEnd) {
+        fuseSumEnd = bitPos + 8;
+      }
+    }
 }
 
 // gets a fuse bit from specific fuse position
@@ -1308,23 +1690,242 @@ static char getFuseBit(unsigned short bitPos) {
     if (pos >= 0xFF00) {
       return pos & 0x1;
     }
+  } else if (seRamMapStat) {
+    pos = seRamMapPos(bitPos >> 3, 0);
   } else {
     pos = bitPos >> 3;
   }
   return (fusemap[pos] & (1 << (bitPos & 7))) ? 1 : 0;
 }
 
+// gets 8 fuse bits at once, the bit position must be a multiple of 8
+static unsigned char getFuseByte(unsigned short bitPos) {
+  uint16_t pos;
+  if (sparseFusemapStat) {
+    pos = sparseGetFuseBit(bitPos);
+    if (pos >= 0xFF00) {
+      return (pos & 0x1) ? 0xFF : 0;
+    }
+  } else if (seRamMapStat) {
+    pos = seRamMapPos(bitPos >> 3, 0);
+  } else {
+    pos = bitPos >> 3;
+  }
+  return fusemap[pos];
+}
+
 static void setFuseBitVal(unsigned short bitPos, char val) {
   if (val) {
     setFuseBit(bitPos);
   }
 }
 
+// streaming write: the fusemap array holds 2 row slots (one row is being programmed while
+// the next one is being received) followed by the UES and CFG fuses
+#define STREAM_ROW_BYTES 22
+#define STREAM_TAIL (2 * STREAM_ROW_BYTES)
+
+static unsigned char* streamDst;
+static unsigned char streamLen;
+static char streamError;
+
+// verification result: one bit per fuse row, the bit after the last row marks UES/CFG mismatch
+static unsigned char rowErrorMap[11];
+
+// returns the fuses of a row packed LSB first for the row shift kernels:
+// the stream slot in streaming mode, otherwise 'buf' filled from the fuse map.
+// JEDEC order: fuses of a row are 'rows' apart, programming order: fuses of a row are adjacent.
+// The row is gathered by one sequential pass over the fuse map instead of a look-up per fuse.
+static const unsigned char* packRowFuses(unsigned char row, unsigned char* buf) {
+  unsigned short addr;
+  unsigned short stride;
+  unsigned char bit;
+
+  if (flagBits & FLAG_BIT_STREAM) {
+    return fusemap + (row & 1) * STREAM_ROW_BYTES;
+  }
+  if (flagBits & FLAG_BIT_ROW_ORDER) {
+    addr = galinfo.bits;
+    addr *= row;
+    stride = 1;
+  } else {
+    addr = row;
+    stride = galinfo.rows;
+  }
+  memset(buf, 0, STREAM_ROW_BYTES);
+  if (sparseFusemapStat) {
+    sparseGatherFuses(addr, stride, galinfo.bits, buf);
+    return buf;
+  }
+  if (seRamMapStat) {
+    for (bit = 0; bit < galinfo.bits; bit++, addr += stride) {
+      if ((fusemap[seRamMapPos(addr >> 3, 0)] >> (addr & 7)) & 1) {
+        buf[bit >> 3] |= (1 << (bit & 7));
+      }
+    }
+    return buf;
+  }
+  for (bit = 0; bit < galinfo.bits; bit++, addr += stride) {
+    if ((fusemap[addr >> 3] >> (addr & 7)) & 1) {
+      buf[bit >> 3] |= (1 << (bit & 7));
+    }
+  }
+  return buf;
+}
+
+// gets an UES or CFG fuse bit (the fuses stored after the fuse row matrix)
+static char getTailFuseBit(unsigned short bitPos) {
+  if (flagBits & FLAG_BIT_STREAM) {
+    bitPos -= galinfo.cfgbase;
+    return (fusemap[STREAM_TAIL + (bitPos >> 3)] >> (bitPos & 7)) & 1;
+  }
+  return getFuseBit(bitPos);
+}
+
+static uint32_t crc32;
+
+// adds a fuse bit to the CRC32 (reflected polynomial 0xEDB88320, bits LSB first)
+static void crcAddBit(char val) {
+  if (val) {
+    crc32 ^= 1;
+  }
+  if (crc32 & 1) {
+    crc32 = (crc32 >> 1) ^ 0xEDB88320UL;
+  } else {
+    crc32 >>= 1;
+  }
+}
+
+// stores a fuse bit read from the fuse row matrix
+static void storeRowFuseBit(unsigned char row, unsigned char bit, char val) {
+  unsigned short addr;
+  if (flagBits & FLAG_BIT_CRC) {
+    crcAddBit(val);
+  } else if (val) {
+    if (flagBits & FLAG_BIT_ROW_ORDER) {
+      addr = galinfo.bits;
+      addr *= row;
+      addr += bit;
+    } else {
+      addr = galinfo.rows;
+      addr *= bit;
+      addr += row;
+    }
+    setFuseBit(addr);
+  }
+}
+
+// sets an UES or CFG fuse bit read from the GAL
+static void setTailFuseBit(unsigned short bitPos) {
+  if (flagBits & FLAG_BIT_CRC) {
+    // kept aside, added to the CRC in JEDEC order after the fuse rows
+    bitPos -= galinfo.cfgbase;
+    fusemap[STREAM_TAIL + (bitPos >> 3)] |= (1 << (bitPos & 7));
+  } else {
+    setFuseBit(bitPos);
+  }
+}
+
+// asks the PC program to send 'len' bytes, the data are picked up later by streamReceive()
+static void streamRequest(unsigned char* dst, unsigned char len) {
+  streamDst = dst;
+  streamLen = len;
+  Serial.print('$');
+  Serial.print((char)('0' + len / 100));
+  Serial.print((char)('0' + (len / 10) % 10));
+  Serial.println((char)('0' + len % 10));
+}
+
+// receives the data requested by streamRequest()
+static void streamReceive(void) {
+  if (streamLen == 0) {
+    return;
+  }
+  if (streamError || Serial.readBytes(streamDst, streamLen) != streamLen) {
+    // the data did not arrive: 1 keeps the fuses in the erased state
+    memset(streamDst, 0xFF, streamLen);
+    streamError = 1;
+  }
+  streamLen = 0;
+}
+
+// called before a fuse row is shifted in. In streaming mode the row data (requested in advance)
+// are received and the next row is requested, so it is transferred while this row is programmed.
+static void loadRowFuses(unsigned char row) {
+  if (flagBits & FLAG_BIT_STREAM) {
+    streamReceive();
+    row++;
+    if (row < galinfo.rows) {
+      streamRequest(fusemap + (row & 1) * STREAM_ROW_BYTES, (galinfo.bits + 7) >> 3);
+    } else {
+      streamRequest(fusemap + STREAM_TAIL, (galinfo.fuses - galinfo.cfgbase + 7) >> 3);
+    }
+  }
+}
+
+// called before UES and CFG fuses are shifted in
+static void loadTailFuses(void) {
+  if (flagBits & FLAG_BIT_STREAM) {
+    streamReceive();
+  }
+}
+
+// starts the streaming mode, returns 0 if the GAL type does not support it
+static char streamBegin(void) {
+  if (galinfo.cfgbase != galinfo.rows * galinfo.bits) { // 600x
+    Serial.println(F("ER streaming not supported"));
+    return 0;
+  }
+  // the fusemap array is reused for the row slots
+  mapUploaded = 0;
+  sparseDisable();
+  seRamMapDisable();
+  streamError = 0;
+  setFlagBit(FLAG_BIT_STREAM, 1);
+  streamRequest(fusemap, (galinfo.bits + 7) >> 3);
+  return 1;
+}
+
+// ends the streaming mode, returns 0 if the data were not received
+static char streamEnd(void) {
+  streamReceive();
+  setFlagBit(FLAG_BIT_STREAM, 0);
+  if (streamError) {
+    Serial.println(F("ER stream failed"));
+    return 0;
+  }
+  return 1;
+}
+
+static void setRowError(unsigned char row) {
+  rowErrorMap[row >> 3] |= (1 << (row & 7));
+}
+
+// returns 1 if the row should be written: always, or in repair mode only the rows that failed
+// the last verification. The row after the last fuse row stands for UES and CFG fuses.
+static char isRowWritten(unsigned char row) {
+  if (flagBits & FLAG_BIT_REPAIR) {
+    return (rowErrorMap[row >> 3] >> (row & 7)) & 1;
+  }
+  return 1;
+}
+
+// prints the per-row verification result, the same bit order as the fuse stream
+static void printRowErrorMap(void) {
+  unsigned char i;
+  Serial.print(F("M "));
+  for (i = 0; i <= (galinfo.rows >> 3); i++) {
+    printFormatedNumberHex2(rowErrorMap[i]);
+  }
+  Serial.println();
+}
+
 // generic fuse-map reading, fuse-map bits are stored in fusemap array
 static void readGalFuseMap(const unsigned char* cfgArray, char useDelay, char doDiscardBits) {
   unsigned short cfgAddr = galinfo.cfgbase;
   unsigned short row, bit;
   unsigned short addr;
+  unsigned char rowBuf[STREAM_ROW_BYTES];
 
   if (flagBits & FLAG_BIT_ATF16V8C) {
       setPV(0);
@@ -1336,17 +1937,12 @@ static void readGalFuseMap(const unsigned char* cfgArray, char useDelay, char do
         setSDIN(0);
         setPV(1);
     }
+    receiveRow(rowBuf, galinfo.bits);
     for(bit = 0; bit < galinfo.bits; bit++) {
-      // check the received bit is 1 and if so then set the fuse map
-      if (receiveBit()) {
-        addr = galinfo.rows;
-        addr *= bit;
-        addr += row;
-        setFuseBit(addr);
-      }
+      storeRowFuseBit(row, bit, (rowBuf[bit >> 3] >> (bit & 7)) & 1);
     }
     if (useDelay) {
-      delay(useDelay);
+      delayUs(timing.rowSettle);
     }
     if (flagBits & FLAG_BIT_ATF16V8C) {
         setPV(0);
@@ -1367,11 +1963,11 @@ static void readGalFuseMap(const unsigned char* cfgArray, char useDelay, char do
     if (receiveBit()) {
       addr = galinfo.uesfuse;
       addr += bit;
-      setFuseBit(addr);
+      setTailFuseBit(addr);
     }
   }
   if (useDelay) {
-    delay(useDelay);
+    delayUs(timing.rowSettle);
   }
   if (flagBits & FLAG_BIT_ATF16V8C) {
       setPV(0);
@@ -1391,11 +1987,11 @@ if (galinfo.cfgmethod == CFG_STROBE_ROW2) { //ATF750C
           break;
         if (receiveBit()) {
           unsigned char cfgOffset = pgm_read_byte(&cfgArray[absBit]);
-          setFuseBit(cfgAddr + cfgOffset);
+          setTailFuseBit(cfgAddr + cfgOffset);
         }
       }
       if (useDelay) {
-        delay(useDelay);
+        delayUs(timing.rowSettle);
       }
     }
   } else {
@@ -1408,12 +2004,12 @@ if (galinfo.cfgmethod == CFG_STROBE_ROW2) { //ATF750C
     }
     else {
       setRow(galinfo.cfgrow);
-      strobe(1);
+      strobe(1000);
     }
     for(bit = 0; bit < galinfo.cfgbits; bit++) {
       if (receiveBit()) {
         unsigned char cfgOffset = pgm_read_byte(&cfgArray[bit]); //read array byte flom flash
-        setFuseBit(cfgAddr + cfgOffset);
+        setTailFuseBit(cfgAddr + cfgOffset);
       }
     }
   }
@@ -1424,10 +2020,10 @@ if (galinfo.cfgmethod == CFG_STROBE_ROW2) { //ATF750C
     if (gal == ATF22V10C) {
       setRow(0);
       sendAddress(6, CFG_ROW_APD);
-      strobe(1);
+      strobe(1000);
     } else { //ATF16V8C
       setRow(CFG_ROW_APD);
-      strobe(1);
+      strobe(1000);
       setPV(1);
     }
     setFlagBit(FLAG_BIT_APD, receiveBit());
@@ -1461,7 +2057,7 @@ static void readGalFuseMap600(const unsigned char* cfgArray) {
           sendBit(bit != row);
       sendBits(24, 0);
       setSDIN(0);
-      strobe(2);
+      strobe(timing.rowStrobe);
       for (bit = 0; bit < 20; bit++)
           setFuseBitVal(78 + 114 * row + bit, receiveBit());
       discardBits(83);
@@ -1476,7 +2072,7 @@ static void readGalFuseMap600(const unsigned char* cfgArray) {
       setFuseBitVal(addr + bit, receiveBit());
   // CFG
   setRow(galinfo.cfgrow);
-  strobe(2);
+  strobe(timing.rowStrobe);
   addr = galinfo.cfgbase;
   for (bit = 0; bit < galinfo.cfgbits; bit++) {
       unsigned char cfgOffset = pgm_read_byte(&cfgArray[bit]); //read array byte flom flash
@@ -1492,6 +2088,13 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
   char fuseBit;   // fuse bit received from GAL
   char mapBit;    // fuse bit stored in RAM
   unsigned short errors = 0;
+  unsigned short rowErrors;
+  unsigned char rowBuf[STREAM_ROW_BYTES];
+  unsigned char mapBuf[STREAM_ROW_BYTES];
+  const unsigned char* mapRow;
+  const unsigned char rowBytes = (galinfo.bits + 7) >> 3;
+  const unsigned char lastMask = 0xFF >> ((8 - (galinfo.bits & 7)) & 7);
+  unsigned char i, diff;
 
 #ifdef DEBUG_VERIFY
   Serial.print(F("rot f:"));
@@ -1504,34 +2107,47 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
 
   // read fuse rows
   for(row = 0; row < galinfo.rows; row++) {
+    loadRowFuses(row);
+    // gather the row before the row is strobed: no fusemap access while the GAL outputs the row
+    mapRow = packRowFuses(row, mapBuf); // bits from RAM
     strobeRow(row);
     if (flagBits & FLAG_BIT_ATF16V8C) {
         setSDIN(0);
         setPV(1);
     }
-    for(bit = 0; bit < galinfo.bits; bit++) {
-      addr = galinfo.rows;
-      addr *= bit;
-      addr += row;
-      mapBit = getFuseBit(addr); //bit from RAM
-      fuseBit = receiveBit(); // read from GAL
-      if (mapBit != fuseBit) {
+    receiveRow(rowBuf, galinfo.bits); // read from GAL
+    // compare 8 fuses at once, count the mismatched bits
+    for (i = 0; i < rowBytes; i++) {
+      diff = rowBuf[i] ^ mapRow[i];
+      if (i == rowBytes - 1) {
+        diff &= lastMask;
+      }
+      if (diff) {
 #ifdef DEBUG_VERIFY
-        Serial.print(F("f a="));
-        Serial.print(addr, DEC);
+        Serial.print(F("f r="));
+        Serial.print(row, DEC);
+        Serial.print(F(" b="));
+        Serial.println(i * 8, DEC);
 #endif
-        errors++;
+        setRowError(row);
+        do {
+          errors++;
+          diff &= diff - 1;
+        } while (diff);
       }
     }
     if (useDelay) {
-      delay(useDelay);
+      delayUs(timing.rowSettle);
     }
     if (flagBits & FLAG_BIT_ATF16V8C) {
       setPV(0);
     }
   }
 
+  rowErrors = errors;
+
    // read UES
+  loadTailFuses();
   strobeRow(galinfo.uesrow);
   if (flagBits & FLAG_BIT_ATF16V8C) {
       setSDIN(0);
@@ -1543,7 +2159,7 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
   for(bit = 0; bit < galinfo.uesbytes * 8; bit++) {
     addr = galinfo.uesfuse;
     addr += bit;
-    mapBit = getFuseBit(addr);
+    mapBit = getTailFuseBit(addr);
     fuseBit = receiveBit();
     if (mapBit != fuseBit) {
 #ifdef DEBUG_VERIFY
@@ -1554,7 +2170,7 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
     }
   }
   if (useDelay) {
-    delay(useDelay);
+    delayUs(timing.rowSettle);
   }
   if (flagBits & FLAG_BIT_ATF16V8C) {
       setPV(0);
@@ -1572,7 +2188,7 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
         if (absBit >= galinfo.cfgbits) {
           break;
         }
-        mapBit = getFuseBit(cfgAddr + pgm_read_byte(&cfgArray[absBit])); // cfgAddr + cfgOffset
+        mapBit = getTailFuseBit(cfgAddr + pgm_read_byte(&cfgArray[absBit])); // cfgAddr + cfgOffset
         fuseBit = receiveBit();
         if (mapBit != fuseBit) {
   #ifdef DEBUG_VERIFY
@@ -1583,7 +2199,7 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
         }
       }
       if (useDelay) {
-        delay(useDelay);
+        delayUs(timing.rowSettle);
       }
     }
   } else {
@@ -1595,11 +2211,11 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
       }
     } else {
       setRow(galinfo.cfgrow);
-      strobe(1);
+      strobe(1000);
     }
     for(bit = 0; bit < galinfo.cfgbits; bit++) {
       unsigned char cfgOffset = pgm_read_byte(&cfgArray[bit]); //read array byte flom flash
-      mapBit = getFuseBit(cfgAddr + cfgOffset);
+      mapBit = getTailFuseBit(cfgAddr + cfgOffset);
       fuseBit = receiveBit();
       if (mapBit != fuseBit) {
   #ifdef DEBUG_VERIFY
@@ -1617,10 +2233,10 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
     if (gal == ATF22V10C) {
       setRow(0);
       sendAddress(6, CFG_ROW_APD);
-      strobe(1);
+      strobe(1000);
     } else { //ATF16V8C
       setRow(CFG_ROW_APD);
-      strobe(1);
+      strobe(1000);
       setPV(1);
     }
 
@@ -1634,6 +2250,10 @@ static unsigned short verifyGalFuseMap(const unsigned char* cfgArray, char useDe
     }
   }
 
+  // UES, CFG and PD fuses are reported after the last fuse row
+  if (errors != rowErrors) {
+    setRowError(galinfo.rows);
+  }
   return errors;
 }
 
@@ -1679,7 +2299,7 @@ static unsigned short verifyGalFuseMap600(const unsigned char* cfgArray) {
           sendBit(bit != row);
       sendBits(24, 0);
       setSDIN(0);
-      strobe(2);
+      strobe(timing.rowStrobe);
       for (bit = 0; bit < 20; bit++) {
           mapBit = getFuseBit(78 + 114 * row + bit);
           fuseBit = receiveBit();
@@ -1721,7 +2341,7 @@ static unsigned short verifyGalFuseMap600(const unsigned char* cfgArray) {
   }
   // CFG
   setRow(galinfo.cfgrow);
-  strobe(2);
+  strobe(timing.rowStrobe);
   addr = galinfo.cfgbase;
   for (bit = 0; bit < galinfo.cfgbits; bit++) {
       unsigned char cfgOffset = pgm_read_byte(&cfgArray[bit]); //read array byte flom flash
@@ -1741,17 +2361,37 @@ static unsigned short verifyGalFuseMap600(const unsigned char* cfgArray) {
 // main fuse-map reading and verification function
 // READING: reads fuse rows, UES, CFG from GAL and stores into fusemap bit array RAM.
 // VERIFY:  reads fuse rows, UES, CFG from GAL and compares with fusemap bit array in RAM.
-static void readOrVerifyGal(char verify)
+// row settle delay used when reading the fuses: 22V10 and 750 types need it
+static char readUseDelay(void)
+{
+  return (gal == GAL22V10 || gal == ATF22V10B || gal == ATF22V10C || gal == ATF750C) ? 1 : 0;
+}
+
+// number of bits to discard before the UES bits are read: 68 cfg bits on ATF22V10, 107 bits on ATF750C
+static unsigned char readDiscardBits(void)
+{
+  if (gal == ATF22V10B || gal == ATF22V10C) {
+    return 68;
+  }
+  if (gal == ATF750C) {
+    return galinfo.bits - 8 * galinfo.uesbytes - 1;
+  }
+  return 0;
+}
+
+static unsigned short readOrVerifyGal(char verify)
 {
   unsigned short i;
   unsigned char* cfgArray = (unsigned char*) cfgV8;
 
+  memset(rowErrorMap, 0, sizeof(rowErrorMap));
+
   //ensure fusemap is cleared before READ operation, keep it for VERIFY operation.
   if (!verify) {
-    for (i = 0; i < MAXFUSES; i++) {
-      fusemap[i] = 0;
-    }
-    sparseSetup(1);
+    clearFuseMap();
+    // fuses read from the GAL are stored in JEDEC order. The serial RAM fusemap keeps
+    // the programming order: a row is then stored sequentially instead of across all cache lines.
+    setFlagBit(FLAG_BIT_ROW_ORDER, seRamMapStat ? 1 : 0);
   }
 
   turnOn(READGAL);
@@ -1765,9 +2405,9 @@ static void readOrVerifyGal(char verify)
         }
         //read without delay, no discard
         if (verify) {
-          i = verifyGalFuseMap(cfgArray, 0, 0);
+          i = verifyGalFuseMap(cfgArray, readUseDelay(), readDiscardBits());
         } else {
-          readGalFuseMap(cfgArray, 0, 0);
+          readGalFuseMap(cfgArray, readUseDelay(), readDiscardBits());
         }
         break;
       
@@ -1781,9 +2421,9 @@ static void readOrVerifyGal(char verify)
         cfgArray = (unsigned char*) galinfo.cfg;
         //read without delay, no discard
         if (verify) {
-          i = verifyGalFuseMap(cfgArray, 0, 0);
+          i = verifyGalFuseMap(cfgArray, readUseDelay(), readDiscardBits());
         } else {
-          readGalFuseMap(cfgArray, 0, 0);
+          readGalFuseMap(cfgArray, readUseDelay(), readDiscardBits());
         }
         break;
 
@@ -1803,46 +2443,174 @@ static void readOrVerifyGal(char verify)
     case ATF22V10C:
       //read with delay 1 ms, discard 68 cfg bits on ATFxx
       if (verify) {
-        i = verifyGalFuseMap(cfgV10, 1, (gal == GAL22V10) ? 0 : 68);
+        i = verifyGalFuseMap(cfgV10, readUseDelay(), readDiscardBits());
       } else {
-        readGalFuseMap(cfgV10, 1, (gal == GAL22V10) ? 0 : 68);
+        readGalFuseMap(cfgV10, readUseDelay(), readDiscardBits());
       } 
       break;
     case ATF750C:
       //read with delay 1 ms, discard 107 bits on ATF750C
       if (verify) {
-        i = verifyGalFuseMap(galinfo.cfg, 1, galinfo.bits - 8 * galinfo.uesbytes - 1);
+        i = verifyGalFuseMap(galinfo.cfg, readUseDelay(), readDiscardBits());
       } else {
-        readGalFuseMap(galinfo.cfg, 1, galinfo.bits - 8 * galinfo.uesbytes - 1);
+        readGalFuseMap(galinfo.cfg, readUseDelay(), readDiscardBits());
       }
   }
   turnOff();
 
+  // the fuses read from the GAL do not fit the sparse fusemap
+  if (!verify && sparseOverflow) {
+    Serial.println(F("ER fuse map is too big"));
+    return 1;
+  }
+
+  // report failing rows (not tracked on 600x)
+  if (verify && galinfo.cfgbase == galinfo.rows * galinfo.bits && ((flagBits & FLAG_BIT_STREAM) || i > 0)) {
+    printRowErrorMap();
+  }
   if (verify && i > 0) {
     Serial.print(F("ER verify failed. Bit errors: "));
     Serial.println(i, DEC);
   }
+  return verify ? i : 0;
 }
 
-// fuse-map writing function for V8 GAL chips
-static void writeGalFuseMapV8(const unsigned char* cfgArray) {
-  unsigned short cfgAddr = galinfo.cfgbase;
-  unsigned char row, rbit;
+// checks that the fuse rows, UES and CFG are erased (all fuses read as 1) using the read
+// sequencing of readGalFuseMap(), stops at the first programmed fuse
+static void blankCheckGal(void)
+{
+  unsigned char row, bit;
+  char blank = 1;
+  const char useDelay = readUseDelay();
+  const unsigned char doDiscardBits = readDiscardBits();
+
+  if (galinfo.cfgbase != galinfo.rows * galinfo.bits) { // 600x
+    Serial.println(F("ER blank check not supported"));
+    return;
+  }
+
+  turnOn(READGAL);
+  if (flagBits & FLAG_BIT_ATF16V8C) {
+      setPV(0);
+  }
+  for (row = 0; blank && row < galinfo.rows; row++) {
+    strobeRow(row);
+    if (flagBits & FLAG_BIT_ATF16V8C) {
+        setSDIN(0);
+        setPV(1);
+    }
+    for (bit = 0; bit < galinfo.bits; bit++) {
+      if (!receiveBit()) {
+        blank = 0;
+        break;
+      }
+    }
+    if (useDelay) {
+      delayUs(timing.rowSettle);
+    }
+    if (flagBits & FLAG_BIT_ATF16V8C) {
+      setPV(0);
+    }
+  }
+  if (!blank) {
+    turnOff();
+    Serial.print(F("OK not blank, row "));
+    Serial.println(row - 1, DEC);
+    return;
+  }
+
+  // UES
+  strobeRow(galinfo.uesrow);
+  if (flagBits & FLAG_BIT_ATF16V8C) {
+      setSDIN(0);
+      setPV(1);
+  }
+  if (doDiscardBits) {
+    discardBits(doDiscardBits);
+  }
+  for (bit = 0; blank && bit < galinfo.uesbytes * 8; bit++) {
+    blank = receiveBit();
+  }
+  if (useDelay) {
+    delayUs(timing.rowSettle);
+  }
+  if (flagBits & FLAG_BIT_ATF16V8C) {
+      setPV(0);
+  }
+  if (!blank) {
+    turnOff();
+    Serial.println(F("OK not blank, UES"));
+    return;
+  }
+
+  // CFG
+  if (galinfo.cfgmethod == CFG_STROBE_ROW2) { //ATF750C
+    const uint8_t cfgstroberow = 96;
+    const uint8_t cfgrowlen = 10;
+    const uint8_t cfgrowcount = (galinfo.cfgbits + (cfgrowlen - 1)) /cfgrowlen;
+    uint8_t i;
+    for (i = 0; blank && i < cfgrowcount; i++) {
+      strobeConfigRow(cfgstroberow + i);
+      for (bit = 0; blank && bit < cfgrowlen && (cfgrowlen * i) + bit < galinfo.cfgbits; bit++) {
+        blank = receiveBit();
+      }
+      if (useDelay) {
+        delayUs(timing.rowSettle);
+      }
+    }
+  } else {
+    if (galinfo.cfgmethod == CFG_STROBE_ROW) {
+      strobeRow(galinfo.cfgrow);
+      if (flagBits & FLAG_BIT_ATF16V8C) {
+        setSDIN(0);
+        setPV(1);
+      }
+    }
+    else {
+      setRow(galinfo.cfgrow);
+      strobe(1000);
+    }
+    for (bit = 0; blank && bit < galinfo.cfgbits; bit++) {
+      blank = receiveBit();
+    }
+  }
+  turnOff();
+
+  if (blank) {
+    Serial.println(F("OK blank"));
+  } else {
+    Serial.println(F("OK not blank, CFG"));
+  }
+}
+
+// fuse-map writing function for V8 GAL chips
+static void writeGalFuseMapV8(const unsigned char* cfgArray) {
+  unsigned short cfgAddr = galinfo.cfgbase;
+  unsigned char row, rbit;
   unsigned short addr;
   unsigned char rbitMax = galinfo.bits;
   const unsigned char skipLastClk = (flagBits & FLAG_BIT_ATF16V8C) ? 1 : 0;
+  unsigned char rowBuf[STREAM_ROW_BYTES];
+  const unsigned char* rowData;
 
   setPV(1);
   // write fuse rows
   for (row = 0; row < galinfo.rows; row++) {
-    setRow(row);
-    for(rbit = 0; rbit < rbitMax; rbit++) {
-      addr = galinfo.rows;
-      addr *= rbit;
-      addr += row;
-      sendBit(getFuseBit(addr), rbit == rbitMax - 1 ? skipLastClk : 0);
+    loadRowFuses(row);
+    if (!isRowWritten(row)) {
+      continue;
     }
-    strobe(progtime);
+    // gather the row before the row address is set: no fusemap access between setRow() and the strobe
+    rowData = packRowFuses(row, rowBuf);
+    setRow(row);
+    sendRow(rowData, rbitMax, skipLastClk);
+    strobe(progUs());
+  }
+
+  loadTailFuses();
+  if (!isRowWritten(galinfo.rows)) {
+    setPV(0);
+    return;
   }
 
   // write UES
@@ -1850,18 +2618,18 @@ static void writeGalFuseMapV8(const unsigned char* cfgArray) {
   for (rbit = 0; rbit < 64; rbit++) {
     addr = galinfo.uesfuse;
     addr += rbit;
-    sendBit(getFuseBit(addr), rbit == 63 ? skipLastClk : 0);
+    sendBit(getTailFuseBit(addr), rbit == 63 ? skipLastClk : 0);
   }
-  strobe(progtime);
+  strobe(progUs());
 
   // write CFG (all ICs use setRow)
   rbitMax = galinfo.cfgbits;
   setRow(galinfo.cfgrow);
   for(rbit = 0; rbit < rbitMax; rbit++) {
     unsigned char cfgOffset = pgm_read_byte(&cfgArray[rbit]); //read array byte flom flash
-    sendBit(getFuseBit(cfgAddr + cfgOffset), rbit == rbitMax - 1 ? skipLastClk : 0);
+    sendBit(getTailFuseBit(cfgAddr + cfgOffset), rbit == rbitMax - 1 ? skipLastClk : 0);
   }
-  strobe(progtime);
+  strobe(progUs());
   setPV(0);
 
   // disable power-down if the APD flag is not set (only for ATF16V8C)
@@ -1878,22 +2646,27 @@ static void writeGalFuseMapV10(const unsigned char* cfgArray, char fillUesStart,
   unsigned char row, bit;
   unsigned short addr;
   unsigned short uesFill = galinfo.bits - galinfo.uesbytes * 8;
+  unsigned char rowBuf[STREAM_ROW_BYTES];
 
   setRow(0); //RA0-5 low
   // write fuse rows
   for (row = 0; row < galinfo.rows; row++) {
-    for (bit = 0; bit < galinfo.bits; bit++) {
-      addr = galinfo.rows;
-      addr *= bit;
-      addr += row;
-      sendBit(getFuseBit(addr));
+    loadRowFuses(row);
+    if (!isRowWritten(row)) {
+      continue;
     }
+    sendRow(packRowFuses(row, rowBuf), galinfo.bits, 0);
     sendAddress(6, row);
     setPV(1);
-    strobe(progtime);
+    strobe(progUs());
     setPV(0);
   }
 
+  loadTailFuses();
+  if (!isRowWritten(galinfo.rows)) {
+    return;
+  }
+
   // write UES
   if (fillUesStart) {
     sendBits(uesFill, 1);
@@ -1901,28 +2674,28 @@ static void writeGalFuseMapV10(const unsigned char* cfgArray, char fillUesStart,
   for (bit = 0; bit < galinfo.uesbytes * 8; bit++) {
     addr = galinfo.uesfuse;
     addr += bit;
-    sendBit(getFuseBit(addr));
+    sendBit(getTailFuseBit(addr));
   }
   if (!fillUesStart) {
     sendBits(uesFill, 1);
   }
   sendAddress(6, galinfo.uesrow);
   setPV(1);
-  strobe(progtime);
+  strobe(progUs());
   setPV(0);
   
   // write CFG
   setRow(galinfo.cfgrow);
   for(bit = 0; bit < galinfo.cfgbits - useSdin; bit++) {
     unsigned char cfgOffset = pgm_read_byte(&cfgArray[bit]); //read array byte flom flash
-    sendBit(getFuseBit(cfgAddr + cfgOffset));
+    sendBit(getTailFuseBit(cfgAddr + cfgOffset));
   }
   if (useSdin) {
     unsigned char cfgOffset = pgm_read_byte(&cfgArray[19]); //read array byte flom flash
-    setSDIN(getFuseBit(cfgAddr + cfgOffset));
+    setSDIN(getTailFuseBit(cfgAddr + cfgOffset));
   }
   setPV(1);
-  strobe(progtime);
+  strobe(progUs());
   setPV(0);
 
   if (useSdin && (flagBits & FLAG_BIT_APD) == 0) {
@@ -1930,7 +2703,7 @@ static void writeGalFuseMapV10(const unsigned char* cfgArray, char fillUesStart,
     setRow(0);
     sendAddress(6, CFG_ROW_APD);
     setPV(1);
-    strobe(progtime);
+    strobe(progUs());
     setPV(0);
   }
 }
@@ -1943,27 +2716,31 @@ static void writeGalFuseMapV750(const unsigned char* cfgArray) {
   unsigned short uesFill = galinfo.bits - (galinfo.uesbytes * 8) - 1;
   uint8_t cfgRowLen = 10; //ATF750C
   uint8_t cfgStrobeRow = 96; //ATF750C
+  unsigned char rowBuf[STREAM_ROW_BYTES];
 	
   // write fuse rows
   setRow(0); //RA0-5 low
   delayMicroseconds(20);
   for(row = 0; row < galinfo.rows; row++) {
-    for (bit = 0; bit < galinfo.bits; bit++) {
-      addr = galinfo.rows;
-      addr *= bit;
-      addr += row;
-      sendBit(getFuseBit(addr));
+    loadRowFuses(row);
+    if (!isRowWritten(row)) {
+      continue;
     }
+    sendRow(packRowFuses(row, rowBuf), galinfo.bits, 0);
 
     sendAddress(7, row);
     setPV(1);
     delayMicroseconds(20);
-    strobe(progtime);
+    strobe(progUs());
     delayMicroseconds(100);
     setPV(0);
     delayMicroseconds(12);
   }
 
+  loadTailFuses();
+  if (!isRowWritten(galinfo.rows)) {
+    return;
+  }
   setRow(0); //RA0-5 low
   sendBits(uesFill, 0); //send X number of 0 bits between fuse rows and UES data
 
@@ -1971,7 +2748,7 @@ static void writeGalFuseMapV750(const unsigned char* cfgArray) {
   for (bit = 0; bit < (8 * galinfo.uesbytes); bit++) {
     addr = galinfo.uesfuse;
     addr += bit;
-    sendBit(getFuseBit(addr));
+    sendBit(getTailFuseBit(addr));
   }
 
   //set 1 bit after UES to 0
@@ -1980,9 +2757,9 @@ static void writeGalFuseMapV750(const unsigned char* cfgArray) {
   row = galinfo.uesrow;
   sendAddress(7, row);
   setPV(1);
-  strobe(progtime);
+  strobe(progUs());
   setPV(0);
-  delay(progtime);
+  delayUs(progUs());
 
   // write CFG
   uint8_t cfgrowcount = (galinfo.cfgbits + (cfgRowLen - 1)) / cfgRowLen;
@@ -1995,7 +2772,7 @@ static void writeGalFuseMapV750(const unsigned char* cfgArray) {
       uint8_t absBit = bit + (i * cfgRowLen);
       //addr = galinfo.cfgbase - (galinfo[gal].bits * rangeStartRow) + cfgArray[absBit];
       addr = galinfo.cfgbase  + pgm_read_byte(&cfgArray[absBit]);
-      uint8_t v = getFuseBit(addr);
+      uint8_t v = getTailFuseBit(addr);
       sendBit(v);
     }
 
@@ -2003,7 +2780,7 @@ static void writeGalFuseMapV750(const unsigned char* cfgArray) {
     delayMicroseconds(10);
     setPV(1);
     delayMicroseconds(18);
-    strobe(progtime); // 20ms
+    strobe(progUs()); // 20ms
     delayMicroseconds(32);
     setPV(0);
     delayMicroseconds(12);
@@ -2016,9 +2793,9 @@ static void writeGalFuseMapV750(const unsigned char* cfgArray) {
     setRow(0);
     sendAddress(7, 125);
     setPV(1);
-    strobe(progtime);
+    strobe(progUs());
     setPV(0);
-    delay(progtime);
+    delayUs(progUs());
   }
 }
 
@@ -2041,7 +2818,7 @@ static void writeGalFuseMap600(const unsigned char* cfgArray) {
         sendBits(16, 0);
         setSDIN(0);
         setPV(1);
-        strobe(progtime);
+        strobe(progUs());
         setPV(0);
     }
     for (row = 0; row < 64; row++)
@@ -2056,7 +2833,7 @@ static void writeGalFuseMap600(const unsigned char* cfgArray) {
             sendBit(getFuseBit(98 + 114 * row + bit));
         setSDIN(0);
         setPV(1);
-        strobe(progtime);
+        strobe(progUs());
         setPV(0);
     }
     // UES
@@ -2070,7 +2847,7 @@ static void writeGalFuseMap600(const unsigned char* cfgArray) {
     sendBits(16, 0);
     setSDIN(0);
     setPV(1);
-    strobe(progtime);
+    strobe(progUs());
     setPV(0);
     // CFG
     setRow(galinfo.cfgrow);
@@ -2081,7 +2858,7 @@ static void writeGalFuseMap600(const unsigned char* cfgArray) {
     }
     setSDIN(0);
     setPV(1);
-    strobe(progtime);
+    strobe(progUs());
     setPV(0);
 }
 
@@ -2133,6 +2910,51 @@ static void writeGal()
   turnOff();
 }
 
+// writes the fuse-map received from the serial line while the GAL is being programmed.
+// Fuse rows are requested one by one (packed, LSB first) followed by the UES and CFG fuses.
+static void writeGalStream(void)
+{
+  if (streamBegin()) {
+    writeGal();
+    if (streamEnd()) {
+      Serial.println(F("OK stream written"));
+    }
+  }
+}
+
+// re-programs the fuse rows that failed the last verification, no erase is done
+static void repairGal(void)
+{
+  unsigned char i;
+  unsigned char failed = 0;
+
+  if (galinfo.cfgbase != galinfo.rows * galinfo.bits) { // 600x
+    Serial.println(F("ER repair not supported"));
+    return;
+  }
+  for (i = 0; i < sizeof(rowErrorMap); i++) {
+    failed |= rowErrorMap[i];
+  }
+  if (!failed) {
+    Serial.println(F("OK no rows to repair"));
+    return;
+  }
+  setFlagBit(FLAG_BIT_REPAIR, 1);
+  writeGal();
+  setFlagBit(FLAG_BIT_REPAIR, 0);
+  Serial.println(F("OK rows repaired"));
+}
+
+// verifies the GAL against the fuse-map received from the serial line (same format
+// as the streaming write). Mismatching rows are reported by the 'M' line.
+static void verifyGalStream(void)
+{
+  if (streamBegin()) {
+    readOrVerifyGal(1);
+    streamEnd();
+  }
+}
+
 // erases fuse-map in the GAL
 static void eraseGAL(char eraseAll)
 {
@@ -2143,7 +2965,7 @@ static void eraseGAL(char eraseAll)
     if (gal == GAL16V8 || gal == ATF16V8B || gal==GAL20V8) {
         sendBit(1);
     }
-    strobe(erasetime);
+    strobe(eraseUs());
     setPV(0);
     turnOff();
 }
@@ -2281,27 +3103,26 @@ static unsigned char addFormatedNumberDec4(unsigned short num, unsigned char i)
   return i + 4;
 }
 
-// calculates fuse-map checksum and returns it
+// calculates fuse-map checksum of the first n fuses and returns it
 static unsigned short checkSum(unsigned short n)
 {
-    unsigned short c, e, i;
-    unsigned long a;
+    unsigned short i, a;
+    unsigned char last;
 
-    c = e= 0;
+    // the running sum covers all the fuses set since the fuse-map was cleared
+    if (fuseSumEnd <= n) {
+      return fuseSum;
+    }
+    // fuses set beyond n: sum the fuse bytes, the last byte may be partial
     a = 0;
-    for (i = 0; i < n; i++) {
-        e++;
-        if (e == 9) {
-          e = 1;
-          a += c;
-          c = 0;
-        }
-        c >>= 1;
-        if (getFuseBit(i)) {
-          c += 0x80;
-        }
+    for (i = 0; i + 8 <= n; i += 8) {
+      a += getFuseByte(i);
+    }
+    if (i < n) {
+      last = getFuseByte(i);
+      a += last & ((1 << (n - i)) - 1);
     }
-    return (unsigned short)((c >> (8 - e)) + a);
+    return a;
 }
 
 static void printGalName() {
@@ -2331,6 +3152,113 @@ static void printGalName() {
     }
 }
 
+// probes the PES with the settings of each known GAL type and selects the first type
+// the PES matches. Prints the detected type with its VPP and timing parameters.
+static void detectGalType(void)
+{
+  GALTYPE orig = gal;
+  char type;
+
+  for (type = 1; type < LAST_GAL_TYPE; type++) {
+    gal = (GALTYPE) type;
+    copyGalInfo();
+    readPes();
+    if (checkGalTypeViaPes() == type) {
+      parsePes(type);
+      setTimingDefaults();
+      pesCached = 1; // the type check of the next operation would read the same PES
+      Serial.print(F("OK type:"));
+      Serial.print(type, DEC);
+      Serial.print(F(" vpp:"));
+      Serial.print(vpp, DEC);
+      Serial.print(F(" prog:"));
+      Serial.print(progtime, DEC);
+      Serial.print(F(" erase:"));
+      Serial.print(erasetime, DEC);
+      Serial.print(' ');
+      printGalName();
+      return;
+    }
+  }
+  gal = orig;
+  copyGalInfo();
+  pesCached = 0;
+  Serial.println(F("ER type not detected"));
+}
+
+// JEDEC order reads of fuse rows stored in programming order (FLAG_BIT_ROW_ORDER).
+// The serial RAM fusemap is not read column by column: 8 fuse columns of all rows are
+// gathered at once (one byte per row) into the start of the fusemap array, which holds
+// only the streaming row slots that are not used while the fuses are printed.
+#define JEDEC_COLS_POS 0
+static unsigned char jedecColGroup; // fuse columns / 8 held by the buffer, 0xFF: none
+
+static void loadJedecColumns(unsigned char group) {
+  unsigned short pos = group << 3; // bit position of the first column in the row
+  unsigned char row, s, v;
+
+  for (row = 0; row < galinfo.rows; row++, pos += galinfo.bits) {
+    s = pos & 7;
+    v = seRamMapPeek(pos >> 3) >> s;
+    if (s) {
+      v |= seRamMapPeek((pos >> 3) + 1) << (8 - s);
+    }
+    fusemap[JEDEC_COLS_POS + row] = v;
+  }
+  jedecColGroup = group;
+}
+
+// gets the fuse bit at the JEDEC position
+static char getJedecFuseBit(unsigned short k) {
+  unsigned short col, row;
+
+  if (!(flagBits & FLAG_BIT_ROW_ORDER) || k >= galinfo.rows * galinfo.bits) {
+    return getFuseBit(k);
+  }
+  col = k / galinfo.rows;
+  row = k % galinfo.rows;
+  if (seRamMapStat) {
+    if ((col >> 3) != jedecColGroup) {
+      loadJedecColumns(col >> 3);
+    }
+    return (fusemap[JEDEC_COLS_POS + row] >> (col & 7)) & 1;
+  }
+  return getFuseBit(row * galinfo.bits + col);
+}
+
+// gets 8 fuse bits at the JEDEC position, the position must be a multiple of 8
+static unsigned char getJedecFuseByte(unsigned short k) {
+  unsigned char i, v = 0;
+
+  if (!(flagBits & FLAG_BIT_ROW_ORDER)) {
+    return getFuseByte(k);
+  }
+  for (i = 0; i < 8; i++) {
+    if (getJedecFuseBit(k + i)) {
+      v |= (1 << i);
+    }
+  }
+  return v;
+}
+
+// fuse-map checksum of the first n fuses in JEDEC order
+static unsigned short jedecCheckSum(unsigned short n)
+{
+    unsigned short i, a;
+
+    if (!(flagBits & FLAG_BIT_ROW_ORDER)) {
+      return checkSum(n);
+    }
+    a = 0;
+    for (i = 0; i + 8 <= n; i += 8) {
+      a += getJedecFuseByte(i);
+    }
+    if (i < n) {
+      a += getJedecFuseByte(i) & ((1 << (n - i)) - 1);
+    }
+    return a;
+}
+
 static unsigned printJedecBlock(unsigned short k, unsigned short bits, unsigned short rows) {
   unsigned short i, j;
   unsigned char unused;
@@ -2340,7 +3268,7 @@ static unsigned printJedecBlock(unsigned short k, unsigned short bits, unsigned
       unused = 1;
       for (j = 0; j < rows; j++)
       {
-        unused &= !getFuseBit(k + j);
+        unused &= !getJedecFuseBit(k + j);
       }
       if (unused) {
         k += rows;
@@ -2352,7 +3280,7 @@ static unsigned printJedecBlock(unsigned short k, unsigned short bits, unsigned
       Serial.print(' ');
       for (j = 0; j < rows; j++, k++)
       {
-          if (getFuseBit(k)) {
+          if (getJedecFuseBit(k)) {
               unused = 0;
               Serial.print('1');
           } else {
@@ -2376,6 +3304,7 @@ static void printJedec()
     Serial.print(F("*QP")); Serial.print(galinfo.pins, DEC);
     Serial.print(F("*QF")); Serial.print(galinfo.fuses + apdFuse, DEC);
     Serial.println(F("*QV0*F0*G0*X0*"));
+    jedecColGroup = 0xFF;
     
     k = 0;
     if (gal == GAL6001 || gal == GAL6002) {
@@ -2468,16 +3397,289 @@ static void printJedec()
     }
     Serial.println('*');
     Serial.print('C');
-    printFormatedNumberHex4(checkSum(galinfo.fuses + apdFuse));
+    printFormatedNumberHex4(jedecCheckSum(galinfo.fuses + apdFuse));
     Serial.println();
     Serial.println('*');
 }
 
+// sends the contents of fuse-map array in a binary frame, the PC program creates the JEDEC file.
+// Frame: 'B' + payload size (4 digits) + new line, payload, 16 bit sum of the payload (LSB first), new line.
+// Payload: flags (bit 0: APD, bit 1: ATF16V8C), fuses packed in JEDEC order (LSB first), PES.
+static void sendFuseFrame(void)
+{
+  unsigned short i;
+  unsigned short n = (galinfo.fuses + 7) >> 3;
+  unsigned short sum;
+  unsigned char v;
+
+  Serial.print('B');
+  printFormatedNumberDec4(1 + n + galinfo.pesbytes);
+  Serial.println();
+
+  v = (flagBits & FLAG_BIT_APD) ? 1 : 0;
+  if (flagBits & FLAG_BIT_ATF16V8C) {
+    v |= 2;
+  }
+  Serial.write(v);
+  sum = v;
+  jedecColGroup = 0xFF;
+  for (i = 0; i < n; i++) {
+    v = getJedecFuseByte(i << 3);
+    Serial.write(v);
+    sum += v;
+  }
+  for (i = 0; i < galinfo.pesbytes; i++) {
+    Serial.write(pes[i]);
+    sum += pes[i];
+  }
+  Serial.write((unsigned char) sum);
+  Serial.write((unsigned char) (sum >> 8));
+  Serial.println();
+}
+
+// reads the GAL and prints CRC32 of its fuses: fuse rows in programming order (row by row),
+// then UES and CFG fuses in JEDEC order. The APD fuse is printed separately.
+static void crcGal(void)
+{
+  unsigned short i;
+
+  if (galinfo.cfgbase != galinfo.rows * galinfo.bits) { // 600x
+    Serial.println(F("ER crc not supported"));
+    return;
+  }
+  crc32 = 0xFFFFFFFFUL;
+  setFlagBit(FLAG_BIT_CRC, 1);
+  readOrVerifyGal(0);
+  setFlagBit(FLAG_BIT_CRC, 0);
+  // the fusemap array was used for UES and CFG fuses
+  mapUploaded = 0;
+  for (i = 0; i < galinfo.fuses - galinfo.cfgbase; i++) {
+    crcAddBit((fusemap[STREAM_TAIL + (i >> 3)] >> (i & 7)) & 1);
+  }
+  crc32 = ~crc32;
+
+  Serial.print(F("OK crc:"));
+  printFormatedNumberHex4(crc32 >> 16);
+  printFormatedNumberHex4(crc32);
+  Serial.print(F(" apd:"));
+  Serial.println((flagBits & FLAG_BIT_APD) ? 1 : 0, DEC);
+}
+
 // helper print function to save RAM space
 static void printNoFusesError() {
   Serial.println(F("ER fuse map not uploaded"));
 }
 
+// Fuse map slots: several uploaded fuse maps are kept in the serial RAM with their GAL type,
+// flags, checksum and a content hash computed by the PC program. A slot is selected as
+// the uploaded fuse map without uploading it again.
+#define SLOT_MAGIC 0x5E07
+#define SLOT_FLAGS (FLAG_BIT_APD | FLAG_BIT_ROW_ORDER)
+#define SLOT_CHUNK 32
+
+typedef struct {
+  uint8_t gal; // UNKNOWN: the slot is empty
+  uint8_t flags;
+  uint16_t fuseSum;
+  uint32_t hash;
+} slot_t;
+
+typedef struct {
+  uint16_t magic;
+  slot_t slot[SERAM_SLOTS];
+} slotDir_t;
+
+static void readSlotDir(slotDir_t* dir) {
+  uint8_t i;
+  seRamReadBlock(SERAM_SLOT_DIR, (uint8_t*) dir, sizeof(slotDir_t));
+  for (i = 0; i < SERAM_SLOTS; i++) {
+    if (dir->magic != SLOT_MAGIC || dir->slot[i].gal >= LAST_GAL_TYPE) {
+      dir->slot[i].gal = UNKNOWN;
+    }
+  }
+  dir->magic = SLOT_MAGIC;
+}
+
+// number of fuse map bytes kept in a slot: the fuses and the APD fuse
+static unsigned short slotBytes(void) {
+  return (galinfo.fuses + ((flagBits & FLAG_BIT_APD) ? 8 : 7)) >> 3;
+}
+
+static void printSlots(void) {
+  slotDir_t dir;
+  uint8_t i;
+
+  readSlotDir(&dir);
+  for (i = 0; i < SERAM_SLOTS; i++) {
+    Serial.print('S');
+    Serial.print(i, DEC);
+    if (dir.slot[i].gal == UNKNOWN) {
+      Serial.println(F(" empty"));
+      continue;
+    }
+    Serial.print(F(" type:"));
+    Serial.print(dir.slot[i].gal, DEC);
+    Serial.print(F(" flags:"));
+    Serial.print(dir.slot[i].flags, DEC);
+    Serial.print(F(" sum:"));
+    Serial.print(dir.slot[i].fuseSum, HEX);
+    Serial.print(F(" hash:"));
+    Serial.println(dir.slot[i].hash, HEX);
+  }
+  Serial.println(F("OK"));
+}
+
+// stores the uploaded fuse map to the slot
+static void storeSlot(uint8_t n) {
+  slotDir_t dir;
+  unsigned char buf[SLOT_CHUNK];
+  unsigned short total = slotBytes();
+  unsigned short i, j;
+  uint32_t hash = parse4hex(4);
+
+  hash <<= 16;
+  hash |= parse4hex(8);
+  if (!mapUploaded || (flagBits & FLAG_BIT_STREAM)) {
+    printNoFusesError();
+    return;
+  }
+  readSlotDir(&dir);
+  // the fuse bytes are gathered first: a fuse map in the serial RAM uses the bus as well
+  for (i = 0; i < total; i += SLOT_CHUNK) {
+    for (j = 0; j < SLOT_CHUNK && i + j < total; j++) {
+      buf[j] = getFuseByte((i + j) << 3);
+    }
+    seRamWriteBlock(SERAM_SLOT_ADDR + (uint32_t) n * SERAM_SLOT_SIZE + i, buf, j);
+  }
+  dir.slot[n].gal = gal;
+  dir.slot[n].flags = flagBits & SLOT_FLAGS;
+  dir.slot[n].fuseSum = fuseSum;
+  dir.slot[n].hash = hash;
+  seRamWriteBlock(SERAM_SLOT_DIR, (uint8_t*) &dir, sizeof(dir));
+  Serial.print(F("OK slot "));
+  Serial.println(n, DEC);
+}
+
+// makes the fuse map of the slot the uploaded fuse map
+static void selectSlot(uint8_t n) {
+  slotDir_t dir;
+  unsigned char buf[SLOT_CHUNK];
+  unsigned short total;
+  unsigned short i, j;
+
+  readSlotDir(&dir);
+  if (dir.slot[n].gal == UNKNOWN) {
+    Serial.println(F("ER slot is empty"));
+    return;
+  }
+  if (gal != dir.slot[n].gal) {
+    pesCached = 0;
+    gal = (GALTYPE) dir.slot[n].gal;
+    setTimingDefaults();
+  }
+  copyGalInfo();
+  flagBits = (flagBits & ~SLOT_FLAGS) | dir.slot[n].flags;
+  clearFuseMap();
+  total = slotBytes(); // the APD flag of the slot is set
+  for (i = 0; i < total; i += SLOT_CHUNK) {
+    seRamReadBlock(SERAM_SLOT_ADDR + (uint32_t) n * SERAM_SLOT_SIZE + i, buf, SLOT_CHUNK);
+    for (j = 0; j < SLOT_CHUNK && i + j < total; j++) {
+      if (buf[j]) {
+        setFuseByte((i + j) << 3, buf[j]);
+      }
+    }
+  }
+  if (fuseSum != dir.slot[n].fuseSum) {
+    mapUploaded = 0;
+    Serial.println(F("ER slot checksum"));
+    return;
+  }
+  mapUploaded = 1;
+  Serial.print(F("OK slot "));
+  Serial.print(n, DEC);
+  Serial.print(F(" type:"));
+  Serial.println((short) gal, DEC);
+}
+
+// 'Sl', 'Ss<n> <hash>', 'Sa<n>', 'Se<n>'
+static void handleSlotCommand(void) {
+  uint8_t n = line[2] - '0';
+
+  if (!seRamPresent) {
+    Serial.println(F("ER no serial RAM"));
+    return;
+  }
+  if (line[1] == 'l') {
+    printSlots();
+    return;
+  }
+  if (n >= SERAM_SLOTS) {
+    Serial.println(F("ER invalid slot"));
+    return;
+  }
+  switch (line[1]) {
+    case 's': storeSlot(n); break;
+    case 'a': selectSlot(n); break;
+    case 'e': {
+      slotDir_t dir;
+      readSlotDir(&dir);
+      dir.slot[n].gal = UNKNOWN;
+      seRamWriteBlock(SERAM_SLOT_DIR, (uint8_t*) &dir, sizeof(dir));
+      Serial.println(F("OK evicted"));
+    } break;
+    default: Serial.println(F("ER unknown slot command"));
+  }
+}
+
+// runs the erase ('c' or '~'), write ('w'), verify ('v') and secure ('s') phases listed
+// after the command letter in one power session. Stops at the first failed phase.
+static void compoundGal(void)
+{
+  char* op;
+
+  for (op = line + 1; *op >= ' '; op++) {
+    if ((*op == COMMAND_WRITE_FUSES || *op == COMMAND_VERIFY_FUSES) && !mapUploaded) {
+      printNoFusesError();
+      return;
+    }
+  }
+
+  powerSession = 1;
+  for (op = line + 1; *op >= ' '; op++) {
+    switch (*op) {
+      case COMMAND_ERASE_GAL:
+      case COMMAND_ERASE_GAL_ALL:
+        eraseGAL(*op == COMMAND_ERASE_GAL_ALL);
+        if (*op == COMMAND_ERASE_GAL_ALL) {
+          pesCached = 0; // PES is erased as well
+        }
+        Serial.println(F("OK erased"));
+        break;
+      case COMMAND_WRITE_FUSES:
+        writeGal();
+        Serial.println(F("OK written"));
+        break;
+      case COMMAND_VERIFY_FUSES:
+        if (readOrVerifyGal(1)) {
+          goto end; // the error is already reported
+        }
+        Serial.println(F("OK verified"));
+        break;
+      case COMMAND_ENABLE_SECURITY:
+        secureGAL();
+        Serial.println(F("OK secured"));
+        break;
+      default:
+        Serial.print(F("ER unknown operation: "));
+        Serial.println(*op);
+        goto end;
+    }
+  }
+end:
+  powerSession = 0;
+  turnOff();
+}
+
 static void testVoltage(int seconds) {
   int i;
 
@@ -2520,13 +3722,18 @@ static void testVoltage(int seconds) {
 // returns 1 if type check if OK, 0 if gal type does not match the type read from PES
 static char doTypeCheck(void) {
   
-  if (0 == flagBits & FLAG_BIT_TYPE_CHECK) {
+  if (0 == (flagBits & FLAG_BIT_TYPE_CHECK)) {
     setGalDefaults();
     return 1; // no need to do type check
   }
+  // the PES of the same chip was already checked in this session
+  if (pesCached) {
+    return 1;
+  }
   readPes();
   parsePes(UNKNOWN);
-  return testProperGAL();
+  pesCached = testProperGAL();
+  return pesCached;
 }
 
 static void measureVpp(uint8_t index) {
@@ -2575,7 +3782,116 @@ static void calibrateVpp(void) {
   }
 }
 
-static void startJtagPlayer(uint8_t vpp) {
+// XSVF stream cache: a stream is received into the serial RAM at full line rate
+// and then played locally without waiting for the PC program. The directory is kept in
+// the serial RAM, so the streams stay resident while the board is powered, even though
+// the MCU is reset when the PC program connects.
+#define XSVF_CACHE_ENTRIES 3
+#define XSVF_CACHE_MAGIC 0xC5A3
+
+typedef struct {
+  uint16_t addr;
+  uint16_t size; // 0: the entry is not used
+  uint32_t crc;
+} xsvfCacheEntry_t;
+
+typedef struct {
+  uint16_t magic;
+  xsvfCacheEntry_t entry[XSVF_CACHE_ENTRIES];
+} xsvfCacheDir_t;
+
+// reads the directory of the cached streams, invalid entries are cleared
+static void xsvfCacheReadDir(xsvfCacheDir_t* dir) {
+  uint8_t i;
+  seRamReadBlock(SERAM_XSVF_DIR, (uint8_t*) dir, sizeof(xsvfCacheDir_t));
+  for (i = 0; i < XSVF_CACHE_ENTRIES; i++) {
+    xsvfCacheEntry_t* e = &dir->entry[i];
+    if (dir->magic != XSVF_CACHE_MAGIC || e->addr < SERAM_XSVF_ADDR || (uint32_t) e->addr + e->size > SERAM_XSVF_END) {
+      e->size = 0;
+    }
+  }
+  dir->magic = XSVF_CACHE_MAGIC;
+}
+
+// 'jc<id> <size> <crc>' receives the XSVF stream into the cache entry <id>
+// unless the stream with the same size (4 hex digits) and CRC32 (8 hex digits) is already cached
+static void loadXsvfCache(void) {
+  xsvfCacheDir_t dir;
+  xsvfCacheEntry_t* e;
+  uint8_t id = line[2] - '0';
+  uint16_t size = parse4hex(4);
+  uint32_t crc = parse4hex(9);
+  uint16_t addr = SERAM_XSVF_ADDR;
+  uint16_t n;
+  uint8_t i;
+
+  crc <<= 16;
+  crc |= parse4hex(13);
+  if (!seRamPresent) {
+    Serial.println(F("ER no serial RAM"));
+    return;
+  }
+  if (id >= XSVF_CACHE_ENTRIES || size == 0 || size > SERAM_XSVF_END - SERAM_XSVF_ADDR) {
+    Serial.println(F("ER invalid XSVF cache entry"));
+    return;
+  }
+  xsvfCacheReadDir(&dir);
+  e = &dir.entry[id];
+  if (e->size == size && e->crc == crc) {
+    Serial.println(F("OK cached"));
+    return;
+  }
+
+  // place the stream after the other cached streams, start over when it does not fit
+  for (i = 0; i < XSVF_CACHE_ENTRIES; i++) {
+    if (i != id && dir.entry[i].size && dir.entry[i].addr + dir.entry[i].size > addr) {
+      addr = dir.entry[i].addr + dir.entry[i].size;
+    }
+  }
+  if ((uint32_t) addr + size > SERAM_XSVF_END) {
+    for (i = 0; i < XSVF_CACHE_ENTRIES; i++) {
+      dir.entry[i].size = 0;
+    }
+    addr = SERAM_XSVF_ADDR;
+  }
+  // the entry is not valid until the whole stream is received
+  e->size = 0;
+  seRamWriteBlock(SERAM_XSVF_DIR, (uint8_t*) &dir, sizeof(dir));
+
+  Serial.println(F("OK send"));
+  crc32 = 0xFFFFFFFFUL;
+  seRamWriteStart(addr);
+  for (n = 0; n < size; n++) {
+    uint32_t start = millis();
+    uint8_t c;
+    while (!Serial.available()) {
+      if (millis() - start > 2000) {
+        Serial.println(F("ER XSVF receive timeout"));
+        return;
+      }
+    }
+    c = Serial.read();
+    seRamWriteData(c, 8);
+    for (i = 0; i < 8; i++) {
+      crcAddBit((c >> i) & 1);
+    }
+  }
+  crc32 = ~crc32;
+  if (crc32 != crc) {
+    Serial.println(F("ER XSVF CRC mismatch"));
+    return;
+  }
+  e->addr = addr;
+  e->size = size;
+  e->crc = crc;
+  seRamWriteBlock(SERAM_XSVF_DIR, (uint8_t*) &dir, sizeof(dir));
+  Serial.print(F("OK loaded "));
+  Serial.println(size, DEC);
+}
+
+// cacheId: '0' - '2' plays the cached stream, 'b' receives the stream with binary credit flow control,
+// otherwise the stream is received from the serial port on '$062' text requests
+static void startJtagPlayer(uint8_t vpp, char cacheId) {
   jtag_port_t jport;
   //assign jtag pins
   jport.tms = 12;
@@ -2586,6 +3902,25 @@ static void startJtagPlayer(uint8_t vpp) {
 
   //Serial.println(vpp ? F("JTAG VPP 1"): F("JTAG VPP 0"));
 
+  xsvf_cache_size = 0;
+  xsvf_credit = (cacheId == 'b') ? 1 : 0;
+  if (cacheId >= '0' && cacheId < '0' + XSVF_CACHE_ENTRIES) {
+    xsvfCacheEntry_t* e;
+    xsvfCacheDir_t dir;
+    if (seRamPresent) {
+      xsvfCacheReadDir(&dir);
+    } else {
+      dir.entry[cacheId - '0'].size = 0;
+    }
+    e = &dir.entry[cacheId - '0'];
+    if (e->size == 0) {
+      Serial.println(F("Q-254,XSVF not cached"));
+      return;
+    }
+    xsvf_cache_addr = e->addr;
+    xsvf_cache_size = e->size;
+  }
+
   // ensure PC app is ready
   delay(200);
   // set VPP if required
@@ -2593,6 +3928,10 @@ static void startJtagPlayer(uint8_t vpp) {
     varVppSet(vpp ? VPP_11V0 : VPP_5V0);
   }
 
+  // the player uses the fusemap array: keep the fusemap in the serial RAM
+  seRamMapFlush();
+  seRamMapInvalidate();
+
   // start XSVF player / processor
   jtag_play_xsvf(&jport);
 
@@ -2640,12 +3979,9 @@ void loop() {
 
       // handle upload command - start the download of fuse-map
       case COMMAND_UPLOAD: {
-        short i;
         // clean fuses
-        for (i = 0; i < MAXFUSES; i++) {
-          fusemap[i] = 0;
-        }
-        sparseSetup(1);
+        clearFuseMap();
+        setFlagBit(FLAG_BIT_ROW_ORDER, 0); // JEDEC order unless '#o' is received
         isUploading = 1;
         uploadError = 0;
       } break;
@@ -2658,6 +3994,8 @@ void loop() {
       // read and print the PES
       case COMMAND_READ_PES : {
         char type;
+        // parsePes() sets VPP and timing of the reported type: the next operation must check the PES again
+        pesCached = 0;
         readPes();
         type = checkGalTypeViaPes();
         parsePes(type);
@@ -2666,6 +4004,7 @@ void loop() {
 
       case COMMAND_WRITE_PES : {
         char type;
+        pesCached = 0;
         type = checkGalTypeViaPes();
         parsePes(type);
         writePes();
@@ -2674,8 +4013,25 @@ void loop() {
       // read fuse-map from the GAL and print it in the JEDEC form
       case COMMAND_READ_FUSES : {
         if (doTypeCheck()) {
-          readOrVerifyGal(0); //just read, no verification
-          printJedec();
+          if (!readOrVerifyGal(0)) { //just read, no verification
+            printJedec();
+          }
+        }
+      } break;
+
+      // read fuse-map from the GAL and send it in a binary frame
+      case COMMAND_READ_FUSES_BINARY : {
+        if (doTypeCheck()) {
+          if (!readOrVerifyGal(0)) { //just read, no verification
+            sendFuseFrame();
+          }
+        }
+      } break;
+
+      // read fuse-map from the GAL and print its CRC32
+      case COMMAND_CRC_FUSES : {
+        if (doTypeCheck()) {
+          crcGal();
         }
       } break;
 
@@ -2691,6 +4047,54 @@ void loop() {
         }
       } break;
 
+      // write fuse-map received from the serial line while programming
+      case COMMAND_STREAM_WRITE : {
+        if (doTypeCheck()) {
+          writeGalStream();
+        }
+      } break;
+
+      // verify fuses against fuse-map received from the serial line
+      case COMMAND_STREAM_VERIFY : {
+        if (doTypeCheck()) {
+          verifyGalStream();
+        }
+      } break;
+
+      // write the rows that failed the last verification
+      case COMMAND_REPAIR_ROWS : {
+        if (mapUploaded) {
+          if (doTypeCheck()) {
+            repairGal();
+          }
+        } else {
+          printNoFusesError();
+        }
+      } break;
+
+      // erase, write, verify and secure in one power session
+      case COMMAND_COMPOUND : {
+        if (doTypeCheck()) {
+          compoundGal();
+        }
+      } break;
+
+      // find the GAL type by reading the PES
+      case COMMAND_DETECT_TYPE : {
+        detectGalType();
+      } break;
+
+      case COMMAND_FUSE_SLOT : {
+        handleSlotCommand();
+      } break;
+
+      // checks the GAL is erased
+      case COMMAND_BLANK_CHECK : {
+        if (doTypeCheck()) {
+          blankCheckGal();
+        }
+      } break;
+
       // erases the fuse-map on the GAL chip
       case COMMAND_ERASE_GAL: {
         if (doTypeCheck()) {
@@ -2701,6 +4105,7 @@ void loop() {
       case COMMAND_ERASE_GAL_ALL: {
         if (doTypeCheck()) {
           eraseGAL(1);
+          pesCached = 0; // PES is erased as well
         }
       } break;
 
@@ -2734,9 +4139,13 @@ void loop() {
       case COMMAND_SET_GAL_TYPE : {
         char type = line[1] - '0';
         if (type >= 1 && type < LAST_GAL_TYPE) {
+          if (gal != type) {
+            pesCached = 0;
+          }
           gal = (GALTYPE) type;
           copyGalInfo();
-          if (0 == flagBits & FLAG_BIT_TYPE_CHECK) { //no type check requested
+          setTimingDefaults();
+          if (0 == (flagBits & FLAG_BIT_TYPE_CHECK)) { //no type check requested
             setGalDefaults();
           }
         } else {
@@ -2746,6 +4155,7 @@ void loop() {
       } break;
       case COMMAND_ENABLE_CHECK_TYPE: {
         setFlagBit(FLAG_BIT_TYPE_CHECK, 1);
+        pesCached = 0;
       } break;
       case COMMAND_DISABLE_CHECK_TYPE: {
         int i = 0;
@@ -2753,6 +4163,12 @@ void loop() {
             pes[i++] = 0;
         }
         setFlagBit(FLAG_BIT_TYPE_CHECK, 0);
+        pesCached = 0;
+      } break;
+
+      // the chip in the socket was replaced: read PES again before the next operation
+      case COMMAND_INVALIDATE_PES: {
+        pesCached = 0;
       } break;
 
       case COMMAND_MEASURE_VPP: {
@@ -2778,7 +4194,11 @@ void loop() {
       } break;
 
       case COMMAND_JTAG_PLAYER: {
-        startJtagPlayer(line[1] == '1');
+        if (line[1] == 'c') {
+          loadXsvfCache();
+          break;
+        }
+        startJtagPlayer(line[1] == '1', line[2]);
         //flush the serial line in case the player ended abruptly
         readGarbage();
       } break;
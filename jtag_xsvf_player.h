@@ -19,6 +19,18 @@ This port:
 
 * reduces the code to a single .h file
 
+* allows to play a stream stored locally (for example in a serial RAM)
+  instead of requesting the data from the serial port. Define XSVF_CACHE_READ
+  to enable such feature, then set xsvf_cache_addr and xsvf_cache_size:
+  #define XSVF_CACHE_READ(ADDR, BUF, LEN) ramRead((ADDR), (BUF), (LEN))
+
+* supports credit based flow control of the serial stream: set xsvf_credit
+  to 1 before the stream is played. Instead of the '$062' text requests
+  the player sends a binary credit token (a single byte: XSVF_CREDIT_TOKEN
+  plus the number of bytes) each time a block of the receive buffer is free.
+  The sender may transmit up to the granted credit without waiting. The
+  token is the only byte with the top bit set the player ever sends.
+
 Use the original JTAG libray python scripts to upload XSVF files
 from your PC:
 ./xsvf -p /dev/ttyACM0 my_file.xsvf
@@ -43,6 +55,13 @@ Arduino usage:
 //value bigger than 63 may cause reading errors on AVR MCUs.
 #define XSVF_BUF_SIZE 62
 
+// credit token: the low 7 bits are the number of bytes the sender may transmit
+#define XSVF_CREDIT_TOKEN 0x80
+// the credit is granted in blocks of at least this size
+#define XSVF_CREDIT_MIN 16
+// credit mode: the time (ms) to wait for the granted bytes
+#define XSVF_CREDIT_TIMEOUT 16000
+
 #define XSVF_DEBUG 0
 #define XSVF_CALC_CSUM 1
 #define XSVF_IGNORE_NOMATCH 0
@@ -206,6 +225,7 @@ typedef struct xsvf_t {
 
   uint32_t rdpos;
   uint32_t wrpos;
+  uint32_t granted; // bytes granted to the sender in credit mode
 
   #if XSVF_CALC_CSUM
   uint32_t csum;
@@ -262,7 +282,12 @@ static const uint16_t xsvf_tms_map[] = {
 };
 #endif
 
+uint8_t xsvf_credit; // 1: credit based flow control of the serial stream
 
+#ifdef XSVF_CACHE_READ
+uint32_t xsvf_cache_addr; // address of the cached stream
+uint32_t xsvf_cache_size; // size of the cached stream, 0: the stream is received from the serial port
+#endif
 
 typedef struct jtag_port_t {
 	uint8_t tms;
@@ -307,10 +332,51 @@ static inline uint8_t jtag_port_get_veref(jtag_port_t* port) {
 }
 
 
+// stores the bytes already received and grants the free space of the buffer to the sender
+static void xsvf_player_credit_poll(void) {
+  uint8_t room;
+
+  while (xsvf->wrpos != xsvf->granted && Serial.available() > 0) {
+    xsvf_buf[xsvf->wrpos % XSVF_BUF_SIZE] = Serial.read();
+    xsvf->wrpos++;
+  }
+  // bytes granted but not consumed yet never exceed the buffer size
+  room = XSVF_BUF_SIZE - (uint8_t)(xsvf->granted - xsvf->rdpos);
+  if (room >= XSVF_CREDIT_MIN) {
+    Serial.write((uint8_t)(XSVF_CREDIT_TOKEN | room));
+    xsvf->granted += room;
+  }
+}
+
 static uint8_t  xsvf_player_next_byte(void) {
   uint8_t retry = 16;
   uint8_t pos =  xsvf->rdpos % XSVF_BUF_SIZE;
 
+#ifdef XSVF_CACHE_READ
+  if (xsvf->wrpos == xsvf->rdpos && xsvf_cache_size) {
+    uint32_t r = XSVF_BUF_SIZE - pos;
+    if (r > xsvf_cache_size - xsvf->rdpos) {
+      r = xsvf_cache_size - xsvf->rdpos;
+    }
+    if (r == 0) {
+      xsvf->error = 1;
+      return 0;
+    }
+    XSVF_CACHE_READ(xsvf_cache_addr + xsvf->rdpos, xsvf_buf + pos, r);
+    xsvf->wrpos += r;
+  }
+#endif
+  if (xsvf_credit) {
+    uint32_t start = millis();
+    xsvf_player_credit_poll();
+    while (xsvf->wrpos == xsvf->rdpos) {
+      if (millis() - start > XSVF_CREDIT_TIMEOUT) {
+        xsvf->error = 1;
+        return 0;
+      }
+      xsvf_player_credit_poll();
+    }
+  } else
   if (xsvf->wrpos == xsvf->rdpos) {
     size_t r = 0;
     while (r == 0) {
@@ -863,7 +929,8 @@ static uint8_t xsvf_player_handle_next_instruction(jtag_port_t* port) {
             cnt++;
           }
         }  else if (c) {
-          Serial.print((char)c);
+          // keep the top bit clear: such bytes are credit tokens
+          Serial.print((char)(c & 0x80 ? '?' : c));
         }
       } while(c);
       Serial.println();
@@ -16,8 +16,19 @@ extern bool               opWrite;
 extern char*              filename;
 extern _str_galinfo       galinfo[];
 extern Galtype            gal;
+extern bool               xsvfCache;
+extern bool               xsvfCredit;
 
-int16_t readJtagSerialLine(char* buf, int16_t bufSize, int16_t maxDelay, int16_t * feedRequest) {
+// XSVF stream cache entries in the programmer's serial RAM
+#define XSVF_CACHE_WRITE 0
+#define XSVF_CACHE_ERASE 1
+#define XSVF_CACHE_ID    2
+
+// binary credit token sent by the player: the low 7 bits are the number of granted bytes
+#define XSVF_CREDIT_TOKEN 0x80
+
+// creditMode: the player was started with binary credit flow control, bytes with the top bit set are credit tokens
+int16_t readJtagSerialLine(char* buf, int16_t bufSize, int16_t maxDelay, int16_t * feedRequest, bool creditMode) {
     char*   bufStart = buf;
     int16_t readSize;
     int16_t bufPos = 0;
@@ -29,6 +40,13 @@ int16_t readJtagSerialLine(char* buf, int16_t bufSize, int16_t maxDelay, int16_t
         if (readSize > 0) {
             bufPos += readSize;
             buf[1] = 0;
+            //handle the credit token: it may arrive in the middle of a text line
+            if (creditMode && ((unsigned char) buf[0] & XSVF_CREDIT_TOKEN)) {
+                *feedRequest += (unsigned char) buf[0] & ~XSVF_CREDIT_TOKEN;
+                bufPos -= readSize;
+                buf[0] = 0;
+                maxDelay = 0; //force exit
+            } else
             //handle the feed request
             if (buf[0] == '$') {
                 char tmp[5];
@@ -83,7 +101,73 @@ int16_t readJtagSerialLine(char* buf, int16_t bufSize, int16_t maxDelay, int16_t
     return bufPos;
 } // readJtagSerialLine()
 
-bool playJtagFile(char* label, int16_t fSize, int16_t vpp, int16_t showProgress) {
+// loads the XSVF stream into the cache entry of the programmer unless it is already cached there
+static bool loadJtagCache(char* label, int16_t fSize, int16_t cacheId, int16_t showProgress) {
+    char     buf[MAX_LINE] = {'\0'};
+    uint32_t crc = 0xFFFFFFFF;
+    int16_t  sendPos = 0;
+    int16_t  feedRequest = 0;
+    int16_t  readBytes;
+    int16_t  i, j;
+
+    for (i = 0; i < fSize; i++) {
+        crc ^= (unsigned char) galbuffer[i];
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        } // for j
+    } // for i
+    crc = ~crc;
+
+    sprintf(buf, "jc%d %04X %08X\r", cacheId, (unsigned int) fSize, (unsigned int) crc);
+    sendBuffer(buf);
+
+    // skip the empty line that follows the command
+    do {
+        readBytes = readJtagSerialLine(buf, MAX_LINE, 3000, &feedRequest, false);
+    } while (readBytes > 0 && buf[0] == 0);
+
+    if (strncmp(buf, "OK cached", 9) == 0) {
+        if (verbose) {
+            printf("%sXSVF is cached\n", label);
+        } // if
+        waitForSerialPrompt(buf, MAX_LINE, 1000);
+        return RETV_OK;
+    } // if
+    if (strncmp(buf, "OK send", 7) != 0) {
+        printf("error: XSVF cache: %s\n", buf);
+        waitForSerialPrompt(buf, MAX_LINE, 1000);
+        return RETV_ERROR;
+    } // if
+
+    // the programmer stores the data as fast as they arrive
+    while (sendPos < fSize) {
+        int16_t chunkSize = fSize - sendPos;
+        int32_t w;
+        if (chunkSize > 256) {
+            chunkSize = 256;
+        } // if
+        w = serialDeviceWrite(serialF, galbuffer + sendPos, chunkSize);
+        if (w < 0) {
+            printf("error: XSVF cache: write failed\n");
+            return RETV_ERROR;
+        } // if
+        sendPos += w;
+        if (showProgress) {
+            updateProgressBar(label, sendPos, fSize);
+        } // if
+    } // while
+
+    readBytes = waitForSerialPrompt(buf, MAX_LINE, 5000);
+    buf[readBytes > 0 ? readBytes : 0] = '\0';
+    if (strstr(buf, "OK loaded") == NULL) {
+        printf("error: XSVF cache: %s\n", stripPrompt(buf));
+        return RETV_ERROR;
+    } // if
+    return RETV_OK;
+} // loadJtagCache()
+
+// cacheId: the cache entry used when the programmer can cache the stream, -1: no caching
+bool playJtagFile(char* label, int16_t fSize, int16_t vpp, int16_t showProgress, int16_t cacheId) {
     char     buf[MAX_LINE] = {'\0'};
     int16_t  sendPos = 0;
     int16_t  lastSendPos = 0;
@@ -91,6 +175,9 @@ bool playJtagFile(char* label, int16_t fSize, int16_t vpp, int16_t showProgress)
     int16_t  result = 0;
     uint16_t csum = 0;
     int16_t  feedRequest = 0;
+    // bytes granted by the player in credit mode and not sent yet
+    int16_t  credit = 0;
+    bool     creditMode = false;
     // support for XCOMMENT messages which might be interrupted by a feed request
     int16_t  continuePrinting = 0;
 
@@ -105,8 +192,20 @@ bool playJtagFile(char* label, int16_t fSize, int16_t vpp, int16_t showProgress)
         } // for 
     } // if
 
-    // send start-JTAG-player command
-    sprintf(buf, "j%d\r", vpp ? 1: 0);
+    // send start-JTAG-player command: play the cached stream or receive the stream while playing
+    if (xsvfCache && cacheId >= 0) {
+        if (loadJtagCache(label, fSize, cacheId, showProgress) != RETV_OK) {
+            closeSerial();
+            return RETV_ERROR;
+        } // if
+        sprintf(buf, "j%d%d\r", vpp ? 1: 0, cacheId);
+    } else
+    if (xsvfCredit) {
+        creditMode = true;
+        sprintf(buf, "j%db\r", vpp ? 1: 0);
+    } else {
+        sprintf(buf, "j%d\r", vpp ? 1: 0);
+    } // else
     sendBuffer(buf);
 
     // read response from MCU and feed the XSVF player with data
@@ -115,9 +214,35 @@ bool playJtagFile(char* label, int16_t fSize, int16_t vpp, int16_t showProgress)
 
         feedRequest = 0;
         buf[0] = 0;
-        readBytes = readJtagSerialLine(buf, MAX_LINE, 3000, &feedRequest);
+        readBytes = readJtagSerialLine(buf, MAX_LINE, 3000, &feedRequest, creditMode);
         //printf(">> read %d  len=%d cp=%d '%s'\n", readBytes, (int16_t) strlen(buf), continuePrinting,  buf);
 
+        //credit was granted: send as many bytes as the player can buffer
+        if (creditMode && feedRequest > 0) {
+            credit += feedRequest;
+            while (ready && credit > 0 && sendPos < fSize) {
+                int16_t chunkSize = fSize - sendPos;
+                int32_t w;
+                if (chunkSize > credit) {
+                    chunkSize = credit;
+                } // if
+                w = serialDeviceWrite(serialF, galbuffer + sendPos, chunkSize);
+                if (w <= 0) {
+                    printf("error: XSVF stream: write failed\n");
+                    closeSerial();
+                    return RETV_ERROR;
+                } // if
+                sendPos += w;
+                credit -= w;
+            } // while
+            if (showProgress && (sendPos - lastSendPos >= 1024 || sendPos == fSize)) {
+                lastSendPos = sendPos;
+                updateProgressBar(label, sendPos, fSize);
+            } // if
+            if (readBytes > 2) {
+                continuePrinting = 1;
+            } // if
+        } else
         //request to send more data was received
         if (feedRequest > 0) {
             if (ready) {
@@ -199,7 +324,7 @@ bool playJtagFile(char* label, int16_t fSize, int16_t vpp, int16_t showProgress)
             continuePrinting = 0;
         } // if
     } // while
-    readJtagSerialLine(buf, MAX_LINE, 1000, &feedRequest);
+    readJtagSerialLine(buf, MAX_LINE, 1000, &feedRequest, creditMode);
     closeSerial();
 	if (!result)
 		 return RETV_ERROR;
@@ -231,7 +356,7 @@ bool processJtagInfo(void) {
     } // if
 
     //play the info file and use high VPP
-    return playJtagFile("", fSize, 1, 0);
+    return playJtagFile("", fSize, 1, 0, XSVF_CACHE_ID);
 } // processJtagInfo()
 
 bool processJtagErase(void) {
@@ -253,7 +378,7 @@ bool processJtagErase(void) {
     filename = originalFname;
 
     //play the erase file and use high VPP
-    return playJtagFile("erase ", fSize, 1, 1);
+    return playJtagFile("erase ", fSize, 1, 1, XSVF_CACHE_ERASE);
 } // processJtagErase()
 
 bool processJtagWrite(void) {
@@ -271,7 +396,7 @@ bool processJtagWrite(void) {
         return RETV_ERROR;
     } // if
     //play the file and use low VPP
-    return playJtagFile("write ", fSize, 0, 1);
+    return playJtagFile("write ", fSize, 0, 1, XSVF_CACHE_WRITE);
 } // processJtagWrite()
 
 bool processJtag(void) {
@@ -9,5 +9,6 @@ bool     processJtagInfo(void);
 bool     processJtagErase(void);
 bool     processJtagWrite(void);
 bool     processJtag(void);
+int16_t  readJtagSerialLine(char* buf, int16_t bufSize, int16_t maxDelay, int16_t * feedRequest, bool creditMode);
 
 #endif /* _AFTB_JTAG_H_ */
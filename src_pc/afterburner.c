@@ -33,13 +33,17 @@ _str_galinfo galinfo[] = {
 
 bool  verbose    = false;
 char* filename   = NULL;
+char* outputFilename = NULL; /* -o: JEDEC file written by the 'r' command */
 char* pesString  = NULL;
+char* timingString = NULL; /* -timing: timing profile fields, for example p=10000,e=50000 */
+int16_t slotIndex  = -1;   /* -slot: fuse map slot of the programmer, -1: not used */
 
 Galtype  gal;
 int16_t  security = 0;
 uint16_t checksum;
 char     galbuffer[GALBUFSIZE];
 char     fusemap[MAXFUSES];
+char     rowmap[MAXFUSES]; /* fuse map in programming order */
 bool     noGalCheck = false;
 bool     varVppExists = false;
 bool     printSerialWhileWaiting = false;
@@ -55,11 +59,28 @@ bool opCalibrateVPP = false; /* calibrate Vpp on new board design */
 bool opMeasureVPP   = false; /* measure Vpp on new board design */
 bool opSecureGal    = false; /* -sec: enable security */
 bool opWritePes     = false; /* write PES */
+bool opVerifyCrc    = false; /* -crc: verify by CRC32 of the chip contents */
+bool opRepair       = false; /* -repair: re-write rows that failed verification */
+bool flagSkipErase  = false; /* --skip-erase-if-blank: do not erase a blank GAL */
+bool flagDetectType = false; /* no -t option: the GAL type is detected by the MCU */
+bool opListSlots    = false; /* list fuse map slots of the programmer */
+bool opEvictSlot    = false; /* evict a fuse map slot of the programmer */
 bool flagEraseAll   = true;  /* erase all data including PES */
 char flagEnableApd  = 0;
 
 extern SerialDeviceHandle serialF; /* defined in serial_port.c */
 extern char* deviceName;
+extern bool  rowOrderUpload;
+extern bool  streamWrite;
+extern bool  streamVerify;
+extern bool  binaryRead;
+extern bool  crc32Fuses;
+extern bool  repairRows;
+extern bool  blankCheck;
+extern bool  compoundOp;
+extern bool  detectType;
+extern bool  timingProfile;
+extern bool  fuseSlots;
 
 void printGalTypes(void) {
     int16_t i;
@@ -78,7 +99,7 @@ void printHelp(void) {
     printf("Afterburner " VERSION_EXTENDED "  a GAL programming tool for Arduino based programmer\n");
     printf("more info: https://github.com/ole00/afterburner\n");
     printf("usage: afterburner command(s) [options]\n");
-    printf("commands: ierwvsbm\n");
+    printf("commands: ierwvsbmlx\n");
     printf("   i : read device info and programming voltage\n");
     printf("   r : read fuse map from the GAL chip and display it, -t option must be set\n");
     printf("   w : write fuse map, -f  and -t options must be set\n");
@@ -88,18 +109,31 @@ void printHelp(void) {
     printf("   s : set VPP ON to check the programming voltage. Ensure the GAL is NOT inserted.\n");
     printf("   b : calibrate variable VPP on new board designs. Ensure the GAL is NOT inserted.\n");
     printf("   m : measure variable VPP on new board designs. Ensure the GAL is NOT inserted.\n");   
+    printf("   l : list the fuse map slots of the programmer (requires serial RAM).\n");
+    printf("   x : evict the fuse map slot set by -slot, or the slot holding the fuse map of -f file.\n");
     printf("options:\n");
     printf("  -v : verbose mode\n");
     printf("  -t <gal_type> : the GAL type. use ");
     printGalTypes();
     printf("\n");
+    printf("                  Without this option the type is detected from the PES of the chip.\n");
     printf("  -f <file> : JEDEC fuse map file\n");
+    printf("  -o <file> : write the fuse map read by 'r' command into a JEDEC file\n");
     printf("  -d <serial_device> : name of the serial device. Without this option the device is guessed.\n");
     printf("                       serial params are: 57600, 8N1\n");
     printf("  -nc : do not check device GAL type before operation: force the GAL type set on command line\n");
     printf("  -sec: enable security - protect the chip. Use with 'w' or 'v' commands.\n");
+    printf("  -crc: verify by comparing CRC32 of the chip contents, the fuse map is not transferred.\n");
+    printf("  -repair: use with 'wv' commands. Re-writes only the rows that failed verification\n");
+    printf("           and verifies the chip again.\n");
     printf("  -co <offset>: Set calibration offset. Use with 'b' command. Value: -20 (-0.2V) to 25 (+0.25V)\n");
     printf("  -all: use with 'e' command to erase all data including PES.\n");
+    printf("  --skip-erase-if-blank: use with 'e' command. Erase is skipped if the fuse rows are blank.\n");
+    printf("  -timing <f=us,...> : override the timing of the chip in microseconds. Fields:\n");
+    printf("               c: extra SCLK high time, r: row read settle time, s: row read strobe,\n");
+    printf("               p: programming pulse, e: erase pulse. For example p=10000,e=50000\n");
+    printf("  -slot <n> : use with 'w' or 'v' commands. The fuse map is kept in slot n (0-3) of the programmer.\n");
+    printf("              When a slot already holds the same fuse map, the slot is used without upload.\n");
     printf("  -pes <PES> : use with 'p' command to specify new PES. PES format is 8 hex bytes with a delimiter.\n");
     printf("               For example 00:03:3A:A1:00:00:00:90\n");
     printf("examples:\n");
@@ -117,13 +151,40 @@ void printHelp(void) {
     printf("        Atmel   ATF16V8B, ATF16V8C, ATF22V10C: 11V \n");
 } // printHelp()
 
+// returns true if the file name has the .xsvf extension (case insensitive): the file is for a JTAG PLD
+static bool isXsvfFile(const char* name) {
+    const char* ext = ".xsvf";
+    int16_t len;
+    int16_t i;
+
+    if (name == NULL) {
+        return false;
+    } // if
+    len = strlen(name);
+    if (len < 5) {
+        return false;
+    } // if
+    name += len - 5;
+    for (i = 0; i < 5; i++) {
+        char c = name[i];
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        } // if
+        if (c != ext[i]) {
+            return false;
+        } // if
+    } // for i
+    return true;
+} // isXsvfFile()
+
 /*-----------------------------------------------------------------------------
   Purpose  : This routine verifies the combination of input options
  Variables : type: a string containing the input options
   Returns  : true: error, false: no error
   ---------------------------------------------------------------------------*/
 bool verifyArgs(char* type) {
-    if (!opRead && !opWrite && !opErase && !opInfo && !opVerify && !opTestVPP && !opCalibrateVPP && !opMeasureVPP && !opWritePes) {
+    if (!opRead && !opWrite && !opErase && !opInfo && !opVerify && !opTestVPP && !opCalibrateVPP && !opMeasureVPP && !opWritePes &&
+        !opListSlots && !opEvictSlot) {
         printHelp();
         printf("Error: no command specified.\n");
         return RETV_ERROR;
@@ -140,9 +201,13 @@ bool verifyArgs(char* type) {
         printf("Error: VPP functions can not be conbined with read/write/verify operations\n");
         return RETV_ERROR;
     }
-    if ((type == NULL) && (opWrite || opRead || opErase || opVerify || opInfo || opWritePes))  {
+    // JTAG PLDs can not be detected by the MCU: the type must be specified
+    if ((type == NULL) && (opWritePes || isXsvfFile(filename)))  {
         printf("Error: missing GAL type. Use -t <type> to specify.\n");
         return RETV_ERROR;
+    } else if ((type == NULL) && (opWrite || opRead || opErase || opVerify || opInfo))  {
+        // the type is detected once the programmer is connected
+        flagDetectType = true;
     } else if (type != NULL) {
         for (int16_t i = 1; i < sizeof(galinfo) / sizeof(galinfo[0]); i++) {
             if (!strcmp(strupr(type), galinfo[i].name)) {
@@ -157,6 +222,10 @@ bool verifyArgs(char* type) {
             return RETV_ERROR;
         } // if
     } // else if
+    if (opEvictSlot && slotIndex < 0 && NULL == filename) {
+        printf("Error: missing slot to evict (param: -slot n or -f fname)\n");
+        return RETV_ERROR;
+    } // if
     if ((NULL == filename) && (opWrite || opVerify)) {
         printf("Error: missing %s filename (param: -f fname)\n", galinfo[gal].id0 == JTAG_ID ? ".xsvf" : ".jed");
         return RETV_ERROR;
@@ -185,16 +254,32 @@ bool checkArgs(int16_t argc, char** argv) {
             verbose = true;
         } else if (!strcmp("-f", param)) {
             filename = argv[++i];
+        } else if (!strcmp("-o", param)) {
+            outputFilename = argv[++i];
         } else if (!strcmp("-d", param)) {
             deviceName = argv[++i];
         } else if (!strcmp("-nc", param)) {
             noGalCheck = true;
         } else if (!strcmp("-sec", param)) {
             opSecureGal = true;
+        } else if (!strcmp("-crc", param)) {
+            opVerifyCrc = true;
+        } else if (!strcmp("-repair", param)) {
+            opRepair = true;
         } else if (!strcmp("-all", param)) {
             flagEraseAll = true;
+        } else if (!strcmp("--skip-erase-if-blank", param)) {
+            flagSkipErase = true;
         }  else if (!strcmp("-pes", param)) {
             pesString = argv[++i];
+        } else if (!strcmp("-timing", param)) {
+            timingString = argv[++i];
+        } else if (!strcmp("-slot", param)) {
+            slotIndex = atoi(argv[++i]);
+            if (slotIndex < 0 || slotIndex > 3) {
+                printf("Error: slot out of range (0..3 inclusive).\n");
+                return RETV_ERROR;
+            } // if
         } else if (!strcmp("-co", param)) {
             calOffset = atoi(argv[++i]);
             if ((calOffset < MIN_CAL_OFFSET) || (calOffset > MAX_CAL_OFFSET)) {
@@ -241,6 +326,12 @@ bool checkArgs(int16_t argc, char** argv) {
         case 'p':
             opWritePes = true;
             break;
+        case 'l':
+            opListSlots = true;
+            break;
+        case 'x':
+            opEvictSlot = true;
+            break;
         default:
             printf("Error: unknown operation '%c' \n", modes[i]);
         } // switch
@@ -253,7 +344,7 @@ bool checkArgs(int16_t argc, char** argv) {
     return RETV_OK;
 } // checkArgs()
 
-uint16_t checkSum(uint16_t n) {
+uint16_t checkSum(char* map, uint16_t n) {
     uint16_t c, e, i;
     uint32_t a;
 
@@ -267,7 +358,7 @@ uint16_t checkSum(uint16_t n) {
             c = 0;
         } // if
         c >>= 1;
-        if (fusemap[i]) {
+        if (map[i]) {
             c += 0x80;
         } // if
     } // for i
@@ -424,7 +515,7 @@ int16_t parseFuseMap(char *ptr) {
     } // for n
 
     if (lastfuse || pins) {
-        uint16_t cs = checkSum(lastfuse);
+        uint16_t cs = checkSum(fusemap, lastfuse);
         if (checksum && (checksum != cs)) {
             printf("Checksum does not match! given=0x%04X calculated=0x%04X last fuse=%i\n", checksum, cs, lastfuse);
         } // if
@@ -515,8 +606,24 @@ void updateProgressBar(char* label, int16_t current, int16_t total) {
     } // else
 } // updateProgressBar()
 
+// Copies the fuse map into the order in which the MCU shifts the fuses into the GAL:
+// the fuse row matrix is stored row by row, UES and CFG fuses stay at their JEDEC positions.
+void transposeFuseMap(char* dst) {
+    int16_t row, bit;
+    int16_t rows = galinfo[gal].rows;
+    int16_t bits = galinfo[gal].bits;
+
+    memcpy(dst, fusemap, MAXFUSES);
+    for (row = 0; row < rows; row++) {
+        for (bit = 0; bit < bits; bit++) {
+            dst[row * bits + bit] = fusemap[bit * rows + row];
+        } // for bit
+    } // for row
+} // transposeFuseMap()
+
 // Upload fusemap in byte format (as opposed to bit format used in JEDEC file).
 bool upload(void) {
+    char*    map = fusemap;
     char     fuseSet;
     char     buf[MAX_LINE];
     char     line[64];
@@ -537,6 +644,17 @@ bool upload(void) {
     sprintf(buf, "#t %c %s\r", '0' + (int16_t) gal, galinfo[gal].name);
     sendLine(buf, MAX_LINE, 300);
 
+    // fuse rows in programming order save the MCU from transposing the fuse map
+    if (rowOrderUpload && gal != GAL6001 && gal != GAL6002) {
+        transposeFuseMap(rowmap);
+        map = rowmap;
+        sprintf(buf, "#o\r");
+        sendLine(buf, MAX_LINE, 300);
+        if (verbose) {
+            printf("using row order upload\n");
+        } // if
+    } // if
+
     // fuse map
     buf[0]  = 0;
     fuseSet = 0;
@@ -561,7 +679,7 @@ bool upload(void) {
         }
         f = 0;
         for (j = 0; j < 8 && i < totalFuses; j++,i++) {
-            if (fusemap[i]) {
+            if (map[i]) {
                 f |= (1 << j);
                 fuseSet = 1;
             }
@@ -580,7 +698,7 @@ bool upload(void) {
 #endif
         sendLine(buf, MAX_LINE, 100);
     }
-    csum = checkSum(totalFuses); //checksum
+    csum = checkSum(map, totalFuses); //checksum
     if (verbose) {
         printf("sending csum: %04X\n", csum);
     }
@@ -591,6 +709,99 @@ bool upload(void) {
     return sendGenericCommand("#e\r", "Upload failed", 300, NO_PRINT); 
 } // upload()
 
+// Prints the fuse rows reported by the 'M' line of the streaming verify.
+static void printRowErrors(char* hex) {
+    int16_t rows = galinfo[gal].rows;
+    int16_t row;
+
+    printf("mismatched rows:");
+    for (row = 0; row <= rows && hex[(row >> 3) * 2 + 1] != 0; row++) {
+        char tmp[3] = {hex[(row >> 3) * 2], hex[(row >> 3) * 2 + 1], 0};
+        if (strtol(tmp, NULL, 16) & (1 << (row & 7))) {
+            if (row == rows) {
+                printf(" ues/cfg");
+            } else {
+                printf(" %d", row);
+            } // else
+        } // if
+    } // for
+    printf("\n");
+} // printRowErrors()
+
+// Writes or verifies the fuse map without uploading it first. The MCU requests the data
+// by feed requests while the GAL is being programmed or read: packed fuse rows
+// (programming order, LSB first), then the UES and CFG fuses.
+bool streamFuseMap(bool doWrite) {
+    char    buf[MAX_LINE];
+    char    stream[MAXFUSES / 8 + 256];
+    int16_t rows = galinfo[gal].rows;
+    int16_t bits = galinfo[gal].bits;
+    int16_t rowBytes = (bits + 7) / 8;
+    int16_t cfgBase = rows * bits;
+    int16_t len = 0;
+    int16_t sendPos = 0;
+    int16_t feedRequest;
+    int16_t row, bit, i;
+    bool    result = RETV_OK;
+    char    rowErrors[64] = {0};
+
+    transposeFuseMap(rowmap);
+    memset(stream, 0, sizeof(stream));
+    for (row = 0; row < rows; row++) {
+        for (bit = 0; bit < bits; bit++) {
+            if (rowmap[row * bits + bit]) {
+                stream[len + (bit >> 3)] |= (1 << (bit & 7));
+            } // if
+        } // for bit
+        len += rowBytes;
+    } // for row
+    for (i = cfgBase; i < galinfo[gal].fuses; i++) {
+        if (rowmap[i]) {
+            stream[len + ((i - cfgBase) >> 3)] |= (1 << ((i - cfgBase) & 7));
+        } // if
+    } // for
+    len += (galinfo[gal].fuses - cfgBase + 7) / 8;
+
+    printf("Streaming fuse map...\n");
+    sprintf(buf, doWrite ? "W\r" : "V\r");
+    if (sendBuffer(buf) != RETV_OK) {
+        return RETV_ERROR;
+    } // if
+
+    // serve the feed requests until the prompt is received
+    while (1) {
+        int16_t readBytes;
+
+        feedRequest = 0;
+        readBytes = readJtagSerialLine(buf, MAX_LINE, 8000, &feedRequest, false);
+        if (readBytes <= 0 && feedRequest == 0) {
+            printf("stream failed: no response\n");
+            return RETV_ERROR;
+        } // if
+        if (feedRequest > 0) {
+            if (sendPos + feedRequest > len) {
+                printf("stream failed: unexpected feed request\n");
+                return RETV_ERROR;
+            } // if
+            serialDeviceWrite(serialF, stream + sendPos, feedRequest);
+            sendPos += feedRequest;
+            updateProgressBar("", sendPos, len);
+        } // if
+        if (buf[0] == 'E' && buf[1] == 'R') {
+            printf("%s\n", buf);
+            result = RETV_ERROR;
+        } else if (buf[0] == 'M' && buf[1] == ' ') {
+            strcpy(rowErrors, buf + 2);
+        } else if (buf[0] == '>') {
+            break;
+        } // else if
+    } // while
+    if (result != RETV_OK && rowErrors[0] != 0) {
+        printRowErrors(rowErrors);
+    } // if
+    return result;
+} // streamFuseMap()
+
 // returns RETV_OK on success
 bool sendGenericCommand(const char* command, const char* errorText, int32_t maxDelay, bool printResult) {
     char    buf[MAX_LINE];
@@ -616,8 +827,230 @@ bool sendGenericCommand(const char* command, const char* errorText, int32_t maxD
     return RETV_OK;
 } // sendGenericCommand()
 
-bool operationWriteOrVerify(bool doWrite) {
-    char    buf[MAX_LINE];
+// Verifies the GAL by comparing CRC32 of the chip contents with CRC32 of the fuse map.
+// CRC is calculated over fuse rows in programming order, then UES and CFG fuses.
+bool operationVerifyCrc(void) {
+    char     buf[MAX_LINE];
+    char*    response;
+    uint32_t crc = 0xFFFFFFFF;
+    uint32_t chipCrc;
+    int16_t  i;
+
+    transposeFuseMap(rowmap);
+    for (i = 0; i < galinfo[gal].fuses; i++) {
+        crc ^= rowmap[i] ? 1 : 0;
+        crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+    } // for i
+    crc = ~crc;
+
+    sprintf(buf, "C\r");
+    if (sendLine(buf, MAX_LINE, 12000) < 0) {
+        return RETV_ERROR;
+    } // if
+    response = strstr(stripPrompt(buf), "OK crc:");
+    if (response == NULL) {
+        printf("%s\n", stripPrompt(buf));
+        return RETV_ERROR;
+    } // if
+    chipCrc = (uint32_t) strtoul(response + 7, NULL, 16);
+    if (verbose) {
+        printf("crc chip: %08X expected: %08X\n", chipCrc, crc);
+    } // if
+    if (chipCrc != crc) {
+        printf("verify failed: CRC32 %08X expected: %08X\n", chipCrc, crc);
+        return RETV_ERROR;
+    } // if
+    response = strstr(response, "apd:");
+    if (response != NULL && (response[4] == '1') != (flagEnableApd != 0)) {
+        printf("verify failed: APD fuse mismatch\n");
+        return RETV_ERROR;
+    } // if
+    return RETV_OK;
+} // operationVerifyCrc()
+
+// Re-programs the rows reported by the last verification (no erase) and verifies again.
+bool operationRepairRows(bool mapUploaded) {
+    bool result;
+
+    printf("Repairing failed rows...\n");
+    // the streaming verify does not keep the fuse map in the MCU
+    if (!mapUploaded) {
+        result = upload();
+        if (result != RETV_OK) {
+            return RETV_ERROR;
+        } // if
+    } // if
+    result = sendGenericCommand("x\r", "repair failed ?", 8000, NO_PRINT);
+    if (result != RETV_OK) {
+        return RETV_ERROR;
+    } // if
+    return sendGenericCommand("v\r", "verify failed ?", 8000, NO_PRINT);
+} // operationRepairRows()
+
+// Content hash of the fuse map: CRC32 of the GAL type, the upload flags and the fuses.
+uint32_t fuseMapHash(void) {
+    uint32_t crc = 0xFFFFFFFF;
+    int16_t  totalFuses = galinfo[gal].fuses + (flagEnableApd ? 1 : 0);
+    int16_t  i, j;
+    unsigned char b[3];
+
+    b[0] = (unsigned char) gal;
+    b[1] = flagEnableApd ? 1 : 0;
+    b[2] = (rowOrderUpload && gal != GAL6001 && gal != GAL6002) ? 1 : 0;
+    for (i = 0; i < 3 + (totalFuses + 7) / 8; i++) {
+        unsigned char c = 0;
+        if (i < 3) {
+            c = b[i];
+        } else {
+            for (j = 0; j < 8 && (i - 3) * 8 + j < totalFuses; j++) {
+                if (fusemap[(i - 3) * 8 + j]) {
+                    c |= (1 << j);
+                } // if
+            } // for j
+        } // else
+        crc ^= c;
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        } // for j
+    } // for i
+    return ~crc;
+} // fuseMapHash()
+
+// Reads the slot list of the programmer into the GAL types (UNKNOWN: empty slot) and
+// the hashes of the slots. Optionally prints the slot list.
+static bool readFuseSlots(Galtype* types, uint32_t* hashes, bool printSlots) {
+    char     buf[MAX_LINE];
+    char*    line;
+    int16_t  i;
+
+    for (i = 0; i < MAX_FUSE_SLOTS; i++) {
+        types[i] = UNKNOWN;
+    } // for i
+    sprintf(buf, "Sl\r");
+    if (sendLine(buf, MAX_LINE, 1000) < 0) {
+        return RETV_ERROR;
+    } // if
+    line = strtok(stripPrompt(buf), "\r\n");
+    while (line != NULL) {
+        int          n, type, flags;
+        unsigned int sum, slotHash;
+        if (sscanf(line, "S%d type:%d flags:%d sum:%X hash:%X", &n, &type, &flags, &sum, &slotHash) == 5) {
+            if (printSlots) {
+                printf("slot %d: %s checksum: %04X hash: %08X\n", n,
+                    (type > 0 && type < ATF1502AS) ? galinfo[type].name : "?", sum, slotHash);
+            } // if
+            if (n >= 0 && n < MAX_FUSE_SLOTS && type > 0 && type < ATF1502AS) {
+                types[n] = (Galtype) type;
+                hashes[n] = slotHash;
+            } // if
+        } else if (printSlots && line[0] == 'S') {
+            printf("slot %s\n", line + 1);
+        } else if (line[0] == 'E' && line[1] == 'R') {
+            printf("%s\n", line);
+        } // else if
+        line = strtok(NULL, "\r\n");
+    } // while
+    return RETV_OK;
+} // readFuseSlots()
+
+// Returns the slot holding the fuse map with the hash and the current GAL type or -1.
+// Optionally prints the slot list.
+int16_t findFuseSlot(uint32_t hash, bool printSlots) {
+    Galtype  types[MAX_FUSE_SLOTS];
+    uint32_t hashes[MAX_FUSE_SLOTS];
+    int16_t  i;
+
+    if (readFuseSlots(types, hashes, printSlots) != RETV_OK) {
+        return -1;
+    } // if
+    for (i = 0; i < MAX_FUSE_SLOTS; i++) {
+        if (types[i] == gal && gal != UNKNOWN && hashes[i] == hash) {
+            return i;
+        } // if
+    } // for i
+    return -1;
+} // findFuseSlot()
+
+// Uploads the fuse map. With the -slot option the fuse map is kept in the programmer's slot
+// and a slot already holding the same fuse map is selected instead of the upload.
+bool uploadFuseMap(void) {
+    char     buf[MAX_LINE];
+    uint32_t hash;
+    int16_t  slot;
+
+    if (slotIndex < 0 || !fuseSlots) {
+        return upload();
+    } // if
+    hash = fuseMapHash();
+    slot = findFuseSlot(hash, false);
+    if (slot >= 0) {
+        if (verbose) {
+            printf("fuse map found in slot %d\n", slot);
+        } // if
+        sprintf(buf, "Sa%d\r", slot);
+        return sendGenericCommand(buf, "slot select failed ?", 4000, NO_PRINT);
+    } // if
+    if (upload() != RETV_OK) {
+        return RETV_ERROR;
+    } // if
+    sprintf(buf, "Ss%d %08X\r", slotIndex, (unsigned int) hash);
+    return sendGenericCommand(buf, "slot store failed ?", 4000, NO_PRINT);
+} // uploadFuseMap()
+
+bool operationListSlots(void) {
+    if (!fuseSlots) {
+        printf("Error: fuse map slots are not supported by the programmer\n");
+        return RETV_ERROR;
+    } // if
+    findFuseSlot(0, true);
+    return RETV_OK;
+} // operationListSlots()
+
+// Evicts the slot set by -slot option or the slot holding the fuse map of the -f file.
+bool operationEvictSlot(void) {
+    char     buf[MAX_LINE];
+    int16_t  slot = slotIndex;
+    Galtype  types[MAX_FUSE_SLOTS];
+    uint32_t hashes[MAX_FUSE_SLOTS];
+    bool     apd = flagEnableApd;
+    Galtype  type = gal; // set by -t option or UNKNOWN
+    int16_t  i;
+
+    if (!fuseSlots) {
+        printf("Error: fuse map slots are not supported by the programmer\n");
+        return RETV_ERROR;
+    } // if
+    if (slot < 0) {
+        // the slots are matched by the hash of the file parsed for the GAL type of each slot:
+        // no GAL needs to be in the socket
+        if (readFile(NULL) || readFuseSlots(types, hashes, false) != RETV_OK) {
+            return RETV_ERROR;
+        } // if
+        for (i = 0; i < MAX_FUSE_SLOTS && slot < 0; i++) {
+            if (types[i] == UNKNOWN || (type != UNKNOWN && types[i] != type)) {
+                continue;
+            } // if
+            gal = types[i];
+            flagEnableApd = apd;
+            parseFuseMap(galbuffer);
+            if (fuseMapHash() == hashes[i]) {
+                slot = i;
+            } // if
+        } // for i
+        if (slot < 0) {
+            printf("fuse map is not in any slot\n");
+            return RETV_OK;
+        } // if
+    } // if
+    if (verbose) {
+        printf("evicting slot %d\n", slot);
+    } // if
+    sprintf(buf, "Se%d\r", slot);
+    return sendGenericCommand(buf, "slot evict failed ?", 1000, NO_PRINT);
+} // operationEvictSlot()
+
+// Reads and parses the JEDEC file and sets the power-down fuse flag in the MCU.
+bool loadFuseMap(void) {
     bool    result;
 
     if (readFile(NULL)) {
@@ -630,26 +1063,101 @@ bool operationWriteOrVerify(bool doWrite) {
     } // if
 
     // set power-down fuse bit (do it before upload to correctly calculate check-sum)
-    result = sendGenericCommand(flagEnableApd ? "z\r" : "Z\r", "APD set failed ?", 4000, NO_PRINT);
-    if (result != RETV_OK) {
+    return sendGenericCommand(flagEnableApd ? "z\r" : "Z\r", "APD set failed ?", 4000, NO_PRINT);
+} // loadFuseMap()
+
+// Erases, writes, verifies and secures the GAL by one command: the MCU keeps the GAL
+// powered between the phases.
+bool operationCompound(void) {
+    char    buf[MAX_LINE];
+    int16_t i = 0;
+
+    if (loadFuseMap() != RETV_OK || uploadFuseMap() != RETV_OK) {
         return RETV_ERROR;
     } // if
-    result = upload();
-    if (result != RETV_OK) {
+
+    buf[i++] = 'a';
+    if (opErase) {
+        buf[i++] = flagEraseAll ? '~' : 'c';
+    } // if
+    buf[i++] = 'w';
+    if (opVerify) {
+        buf[i++] = 'v';
+    } // if
+    if (opSecureGal) {
+        buf[i++] = 's';
+    } // if
+    buf[i++] = '\r';
+    buf[i] = 0;
+    if (verbose) {
+        printf("sending '%s' command...\n", buf);
+    } // if
+    return sendGenericCommand(buf, "compound operation failed ?", 30000, verbose ? DO_PRINT : NO_PRINT);
+} // operationCompound()
+
+bool operationWriteOrVerify(bool doWrite) {
+    char    buf[MAX_LINE];
+    bool    result;
+    bool    doVerify = opVerify;
+    bool    doVerifyCrc = false;
+    bool    mapUploaded = false;
+    bool    verifyFailed = false;
+
+    if (loadFuseMap() != RETV_OK) {
         return RETV_ERROR;
     } // if
 
-    // write command
-    if (doWrite) {
-        result = sendGenericCommand("w\r", "write failed ?", 8000, NO_PRINT);
+    // verification by CRC32 of the chip contents: the fuse map is not transferred
+    if (opVerify && opVerifyCrc && crc32Fuses && gal != GAL6001 && gal != GAL6002) {
+        doVerify = false;
+        doVerifyCrc = true;
+    } // if
+
+    // stream the fuse map while programming / verifying, no need to upload it
+    // the fuse map is uploaded when it is kept in a slot
+    if ((streamWrite || !doWrite) && (streamVerify || !doVerify) && gal != GAL6001 && gal != GAL6002 &&
+        !(slotIndex >= 0 && fuseSlots)) {
+        if (verbose) {
+            printf("using fuse map streaming\n");
+        } // if
+        if (doWrite) {
+            result = streamFuseMap(DO_WRITE);
+            if (result != RETV_OK) {
+                return RETV_ERROR;
+            } // if
+        } // if
+        if (doVerify) {
+            result = streamFuseMap(NO_WRITE);
+            verifyFailed = (result != RETV_OK);
+        } // if
+    } else {
+        result = uploadFuseMap();
         if (result != RETV_OK) {
-			return RETV_ERROR;
+            return RETV_ERROR;
+        } // if
+        mapUploaded = true;
+
+        // write command
+        if (doWrite) {
+            result = sendGenericCommand("w\r", "write failed ?", 8000, NO_PRINT);
+            if (result != RETV_OK) {
+                return RETV_ERROR;
+            } // if
         } // if
+
+        // verify command
+        if (doVerify) {
+            result = sendGenericCommand("v\r", "verify failed ?", 8000, NO_PRINT);
+            verifyFailed = (result != RETV_OK);
+        } // if
+    } // else
+
+    if (verifyFailed && doWrite && opRepair && repairRows && gal != GAL6001 && gal != GAL6002) {
+        result = operationRepairRows(mapUploaded);
     } // if
 
-    // verify command
-    if (opVerify) {
-        result = sendGenericCommand("v\r", "verify failed ?", 8000, NO_PRINT);
+    if (result == RETV_OK && doVerifyCrc) {
+        result = operationVerifyCrc();
     } // if
     return result;
 } // operationWriteOrVerify()
@@ -745,6 +1253,80 @@ bool operationSetGalType(Galtype type) {
     return result;    
 } // operationSetGalType()
 
+// Asks the MCU to find the GAL type by probing the PES with the settings of the known types.
+bool operationDetectGalType(void) {
+    char    buf[MAX_LINE];
+    char*   response;
+    int16_t type;
+
+    if (!detectType) {
+        printf("Error: missing GAL type. Use -t <type> to specify.\n");
+        return RETV_ERROR;
+    } // if
+    if (verbose) {
+        printf("sending 'T' command...\n");
+    } // if
+    sprintf(buf, "T\r");
+    // each probed type powers the GAL up and down
+    if (sendLine(buf, MAX_LINE, 20000) < 0) {
+        return RETV_ERROR;
+    } // if
+    response = strstr(stripPrompt(buf), "OK type:");
+    if (response == NULL) {
+        printf("%s\n", stripPrompt(buf));
+        printf("Error: GAL type not detected. Use -t <type> to specify.\n");
+        return RETV_ERROR;
+    } // if
+    type = (int16_t) atoi(response + 8);
+    if (type <= UNKNOWN || type >= ATF1502AS) {
+        printf("Error: unexpected GAL type %i detected\n", type);
+        return RETV_ERROR;
+    } // if
+    gal = (Galtype) type;
+    printf("detected GAL type: %s\n", galinfo[gal].name);
+    if (verbose) {
+        printf("%s\n", response);
+    } // if
+    return RETV_OK;
+} // operationDetectGalType()
+
+// Uploads the timing profile fields given by the -timing option. The MCU keeps them
+// until the GAL type is set again.
+bool operationSetTiming(void) {
+    char     buf[MAX_LINE];
+    char*    p = timingString;
+    char     field;
+    uint32_t t;
+    bool     result;
+
+    if (!timingProfile) {
+        printf("Error: timing profile is not supported by the programmer firmware\n");
+        return RETV_ERROR;
+    } // if
+    sprintf(buf, "u\r");
+    sendLine(buf, MAX_LINE, 20);
+    while (*p) {
+        field = *p++;
+        if (strchr("crspe", field) == NULL || *p++ != '=') {
+            printf("Error: invalid timing profile '%s'\n", timingString);
+            sprintf(buf, "#e\r");
+            sendLine(buf, MAX_LINE, 300);
+            return RETV_ERROR;
+        } // if
+        t = (uint32_t) strtoul(p, &p, 10);
+        if (verbose) {
+            printf("timing %c: %u us\n", field, (unsigned int) t);
+        } // if
+        sprintf(buf, "#s %c %08X\r", field, (unsigned int) t);
+        sendLine(buf, MAX_LINE, 300);
+        if (*p == ',') {
+            p++;
+        } // if
+    } // while
+    result = sendGenericCommand("#e\r", "timing upload failed ?", 300, NO_PRINT);
+    return result;
+} // operationSetTiming()
+
 bool operationSecureGal(void) {
     bool    result;
 
@@ -798,6 +1380,21 @@ bool operationEraseGal(void) {
     sprintf(buf, "#e\r");
     sendLine(buf, MAX_LINE, 100);
 
+    // blank check takes milliseconds, erase is the slow part of the cycle
+    if (flagSkipErase && blankCheck && gal != GAL6001 && gal != GAL6002) {
+        sprintf(buf, "k\r");
+        if (sendLine(buf, MAX_LINE, 4000) < 0) {
+            return RETV_ERROR;
+        } // if
+        if (strstr(buf, "OK blank") != NULL) {
+            printf("GAL is blank, erase skipped\n");
+            return RETV_OK;
+        } // if
+        if (verbose) {
+            printf("%s\n", stripPrompt(buf));
+        } // if
+    } // if
+
     if (flagEraseAll) {
         result = sendGenericCommand("~\r", "erase all failed ?", 4000, NO_PRINT);
     } else {
@@ -806,6 +1403,170 @@ bool operationEraseGal(void) {
     return result;
 } // operationEraseGal()
 
+// prints one block of the fuse row matrix, columns without any fuse set are skipped
+static int16_t printJedecBlock(FILE* f, int16_t k, int16_t bits, int16_t rows) {
+    int16_t i, j;
+    bool    unused;
+
+    for (i = 0; i < bits; i++) {
+        unused = true;
+        for (j = 0; j < rows; j++) {
+            if (fusemap[k + j]) {
+                unused = false;
+            } // if
+        } // for j
+        if (!unused) {
+            fprintf(f, "L%04d ", k);
+            for (j = 0; j < rows; j++) {
+                fputc(fusemap[k + j] ? '1' : '0', f);
+            } // for j
+            fprintf(f, "*\n");
+        } // if
+        k += rows;
+    } // for i
+    return k;
+} // printJedecBlock()
+
+// Writes the fuse map in the JEDEC form, the layout is the same as the one printed by the MCU.
+static void printJedec(FILE* f, bool atf16v8c, bool apd, unsigned char* pes) {
+    int16_t i, j, k;
+    int16_t apdFuse = apd ? 1 : 0;
+    int16_t fuses = galinfo[gal].fuses;
+
+    fprintf(f, "JEDEC file for %s\n", atf16v8c ? "ATF16V8C" : galinfo[gal].name);
+    fprintf(f, "*QP%d*QF%d*QV0*F0*G0*X0*\n", galinfo[gal].pins, fuses + apdFuse);
+
+    if (gal == GAL6001 || gal == GAL6002) {
+        k = printJedecBlock(f, 0, 64, 114);
+        k = printJedecBlock(f, k, 11, 78);
+    } else {
+        k = printJedecBlock(f, 0, galinfo[gal].bits, galinfo[gal].rows);
+    } // else
+
+    if (k < galinfo[gal].uesfuse) {
+        fprintf(f, "L%04d ", k);
+        while (k < galinfo[gal].uesfuse) {
+            fputc(fusemap[k++] ? '1' : '0', f);
+        } // while
+        fprintf(f, "*\n");
+    } // if
+
+    // UES in byte form
+    fprintf(f, "N UES");
+    for (j = 0; j < galinfo[gal].uesbytes; j++) {
+        uint8_t n = 0;
+        for (i = 0; i < 8; i++) {
+            if (fusemap[k + 8 * j + i]) {
+                if (gal == ATF22V10C || gal == ATF750C) {
+                    n |= 1 << (7 - i); // big-endian
+                } else {
+                    n |= 1 << i; // little-endian
+                } // else
+            } // if
+        } // for i
+        fprintf(f, " %02X", n);
+    } // for j
+    fprintf(f, "*\n");
+
+    // UES in bit form
+    fprintf(f, "L%04d ", k);
+    for (j = 0; j < 8 * galinfo[gal].uesbytes; j++) {
+        fputc(fusemap[k++] ? '1' : '0', f);
+    } // for j
+    fprintf(f, "*\n");
+
+    // CFG bits
+    if (k < fuses) {
+        fprintf(f, "L%04d ", k);
+        while (k < fuses) {
+            fputc(fusemap[k++] ? '1' : '0', f);
+        } // while
+        if (apd) { // ATF16V8C
+            fputc('1', f);
+        } // if
+        fprintf(f, "*\n");
+    } else if (apd) { // ATF22V10C
+        fprintf(f, "L%04d 1*\n", k);
+    } // else if
+
+    fprintf(f, "N PES");
+    for (i = 0; i < galinfo[gal].pesbytes; i++) {
+        fprintf(f, " %02X", pes[i]);
+    } // for i
+    fprintf(f, "*\n");
+    fprintf(f, "C%04X\n*\n", checkSum(fusemap, fuses + apdFuse));
+} // printJedec()
+
+// Reads the fuse map in a binary frame and creates the JEDEC text on the PC side.
+static bool readFusesBinary(void) {
+    char     buf[MAX_LINE];
+    unsigned char* frame = (unsigned char*) galbuffer;
+    int16_t  feedRequest = 0;
+    int16_t  len = 0;
+    int16_t  fuses = galinfo[gal].fuses;
+    int16_t  i;
+    uint16_t sum = 0;
+    FILE*    f = stdout;
+
+    sprintf(buf, "R\r");
+    if (sendBuffer(buf) != RETV_OK) {
+        return RETV_ERROR;
+    } // if
+
+    // wait for the frame header, reading the GAL takes a while
+    while (len == 0) {
+        if (readJtagSerialLine(buf, MAX_LINE, 12000, &feedRequest, false) <= 0) {
+            printf("read failed: no response\n");
+            return RETV_ERROR;
+        } // if
+        if (buf[0] == 'E' && buf[1] == 'R') {
+            printf("%s\n", buf);
+            waitForSerialPrompt(buf, MAX_LINE, 1000);
+            return RETV_ERROR;
+        } // if
+        if (buf[0] == 'B') {
+            len = atoi(buf + 1);
+        } // if
+    } // while
+
+    // payload, 2 bytes of the sum, new line
+    if (len != 1 + (fuses + 7) / 8 + galinfo[gal].pesbytes || readSerialBytes(galbuffer, len + 2, 4000) != len + 2) {
+        printf("read failed: invalid fuse map frame\n");
+        return RETV_ERROR;
+    } // if
+    for (i = 0; i < len; i++) {
+        sum += frame[i];
+    } // for i
+    if (sum != (frame[len] | (frame[len + 1] << 8))) {
+        printf("read failed: fuse map frame checksum mismatch\n");
+        return RETV_ERROR;
+    } // if
+    waitForSerialPrompt(buf, MAX_LINE, 1000);
+
+    // unpack the fuses
+    memset(fusemap, 0, sizeof(fusemap));
+    for (i = 0; i < fuses; i++) {
+        fusemap[i] = (frame[1 + (i >> 3)] >> (i & 7)) & 1;
+    } // for i
+    if (frame[0] & 1) { // APD fuse follows the last fuse
+        fusemap[fuses] = 1;
+    } // if
+
+    if (outputFilename != NULL) {
+        f = fopen(outputFilename, "wb");
+        if (f == NULL) {
+            printf("Error: failed to open file '%s'\n", outputFilename);
+            return RETV_ERROR;
+        } // if
+    } // if
+    printJedec(f, frame[0] & 2, frame[0] & 1, frame + 1 + (fuses + 7) / 8);
+    if (f != stdout) {
+        fclose(f);
+        printf("fuse map written to %s\n", outputFilename);
+    } // if
+    return RETV_OK;
+} // readFusesBinary()
+
 bool operationReadFuses(void) {
     char*   response;
     char*   buf = galbuffer;
@@ -823,6 +1584,11 @@ bool operationReadFuses(void) {
     sprintf(buf, "#e\r");
     sendLine(buf, MAX_LINE, 1000);
 
+    // binary frame is ~8x smaller than the JEDEC text
+    if (binaryRead) {
+        return readFusesBinary();
+    } // if
+
     //READ_FUSE command
     sprintf(buf, "r\r");
     readSize = sendLine(buf, 32768, 12000);
@@ -831,16 +1597,29 @@ bool operationReadFuses(void) {
     } // if
 	printf("OK!\n");
     response = stripPrompt(buf);
-    printf("%s\n", response);
 
     if (response[0] == 'E' && response[1] == 'R') {
+        printf("%s\n", response);
         return RETV_ERROR;
     } // if
+    if (outputFilename != NULL) {
+        FILE* f = fopen(outputFilename, "wb");
+        if (f == NULL) {
+            printf("Error: failed to open file '%s'\n", outputFilename);
+            return RETV_ERROR;
+        } // if
+        fprintf(f, "%s\n", response);
+        fclose(f);
+        printf("fuse map written to %s\n", outputFilename);
+    } else {
+        printf("%s\n", response);
+    } // else
     return RETV_OK;
 } // operationReadFuses()
 
 int16_t main(int16_t argc, char** argv) {
     bool    result = false;
+    bool    compound = false;
     int16_t i;
 
     if (checkArgs(argc, argv) != RETV_OK) {
@@ -860,16 +1639,28 @@ int16_t main(int16_t argc, char** argv) {
 		} // if
 
 		result = operationSetGalCheck();
+		if (flagDetectType && (result == RETV_OK)) {
+			result = operationDetectGalType();
+		} // if
 		if ((gal != UNKNOWN) && (result == RETV_OK)) {
 			result = operationSetGalType(gal);
 		} // if
+		if ((timingString != NULL) && (result == RETV_OK)) {
+			result = operationSetTiming();
+		} // if
+
+		// erase, write, verify and secure in one MCU command (one power-on of the GAL)
+		compound = compoundOp && opWrite && (opErase || opVerify || opSecureGal) &&
+			!opVerifyCrc && !opRepair && !flagSkipErase;
 
-		if (opErase && (result == RETV_OK)) {
+		if (opErase && !compound && (result == RETV_OK)) {
 			result = operationEraseGal();
 		} // if
 
 		if (result == RETV_OK) {
-			if (opWrite) {
+			if (opWrite && compound) {
+				result = operationCompound();
+			} else if (opWrite) {
 				result = operationWriteOrVerify(DO_WRITE); // writing fuses and optionally verification
 			} else if (opInfo) {
 				result = operationReadInfo();
@@ -881,8 +1672,12 @@ int16_t main(int16_t argc, char** argv) {
 				result = operationTestVpp();
 			} else if (opWritePes) {
 				result = operationWritePes();
+			} else if (opListSlots) {
+				result = operationListSlots();
+			} else if (opEvictSlot) {
+				result = operationEvictSlot();
 			} // else if
-			if ((result == RETV_OK) && (opWrite || opVerify)) {
+			if ((result == RETV_OK) && (opWrite || opVerify) && !compound) {
 				if (opSecureGal) {
 					operationSecureGal();
 				} // if
@@ -55,6 +55,8 @@ To compile: gcc -g3 -O0 -o afterburner afterburner.c
 #define MAXFUSES   (30000)
 #define GALBUFSIZE (256 * 1024)
 
+#define MAX_FUSE_SLOTS (8) /* fuse map slots listed by the programmer */
+
 #define MIN_CAL_OFFSET (-32) /* Min. calibration offset in [E-2 V] */
 #define MAX_CAL_OFFSET  (32) /* Max. calibration offset in [E-2 V] */
 
@@ -132,13 +134,22 @@ void     printGalTypes(void);
 void     printHelp(void);
 bool     verifyArgs(char* type);
 bool     checkArgs(int16_t argc, char** argv);
-uint16_t checkSum(uint16_t n);
+uint16_t checkSum(char* map, uint16_t n);
 int16_t  parseFuseMap(char *ptr);
 bool     readFile(int16_t* fileSize);
 char*    findLastLine(char* buf);
 void     updateProgressBar(char* label, int16_t current, int16_t total);
+void     transposeFuseMap(char* dst);
 bool     upload(void);
+uint32_t fuseMapHash(void);
+int16_t  findFuseSlot(uint32_t hash, bool printSlots);
+bool     uploadFuseMap(void);
+bool     streamFuseMap(bool doWrite);
 bool     sendGenericCommand(const char* command, const char* errorText, int32_t maxDelay, bool printResult);
+bool     operationVerifyCrc(void);
+bool     operationRepairRows(bool mapUploaded);
+bool     loadFuseMap(void);
+bool     operationCompound(void);
 bool     operationWriteOrVerify(bool doWrite);
 bool     operationReadInfo(void);
 bool     operationTestVpp(void);
@@ -146,9 +157,13 @@ bool     operationCalibrateVpp(void);
 bool     operationMeasureVpp(void);
 bool     operationSetGalCheck(void);
 bool     operationSetGalType(Galtype type);
+bool     operationDetectGalType(void);
+bool     operationSetTiming(void);
 bool     operationSecureGal();
 bool     operationWritePes(void);
 bool     operationEraseGal(void);
 bool     operationReadFuses(void);
+bool     operationListSlots(void);
+bool     operationEvictSlot(void);
 
 #endif /* _AFTERBURNER_H_ */
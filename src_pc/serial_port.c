@@ -6,6 +6,19 @@ SerialDeviceHandle serialF = INVALID_HANDLE;
 
 char* deviceName = NULL;
 bool  bigRam     = false; // 'BIG-RAM found
+bool  rowOrderUpload = false; // fuse rows can be uploaded in programming order
+bool  streamWrite = false; // fuse rows can be streamed while the GAL is being programmed
+bool  streamVerify = false; // fuse rows can be streamed while the GAL is being verified
+bool  binaryRead = false; // fuse map can be read in a binary frame
+bool  crc32Fuses = false; // CRC32 of the chip contents can be computed by the MCU
+bool  repairRows = false; // rows that failed verification can be re-written
+bool  blankCheck = false; // blank check of the fuse rows
+bool  compoundOp = false; // erase, write, verify and secure by one command
+bool  detectType = false; // GAL type can be detected by the MCU
+bool  timingProfile = false; // timing profile can be uploaded
+bool  xsvfCache = false; // XSVF streams can be cached in the serial RAM of the programmer
+bool  fuseSlots = false; // fuse maps can be kept in slots in the serial RAM of the programmer
+bool  xsvfCredit = false; // XSVF stream is fed with binary credit flow control
 
 extern bool verbose;
 extern bool varVppExists;
@@ -264,6 +277,19 @@ bool openSerial(void) {
     labelPos = strstr(buf, "AFTerburner v.") -  buf;
 
     bigRam = false;
+    rowOrderUpload = false;
+    streamWrite = false;
+    streamVerify = false;
+    binaryRead = false;
+    crc32Fuses = false;
+    repairRows = false;
+    blankCheck = false;
+    compoundOp = false;
+    detectType = false;
+    timingProfile = false;
+    xsvfCache = false;
+    fuseSlots = false;
+    xsvfCredit = false;
     if ((labelPos >= 0) && (labelPos < 500) && (buf[total - 3] == '>')) {
         // check for new board desgin: variable VPP
         varVppExists = checkForString(buf, labelPos, " varVpp ");
@@ -275,6 +301,31 @@ bool openSerial(void) {
         if (verbose && bigRam) {
             printf("MCU Big RAM detected\n");
         } // if
+        // check for programming order upload
+        rowOrderUpload = checkForString(buf, labelPos, " rowOrder ");
+        // check for streaming write
+        streamWrite = checkForString(buf, labelPos, " streamWrite ");
+        streamVerify = checkForString(buf, labelPos, " streamVerify ");
+        // check for binary fuse map read
+        binaryRead = checkForString(buf, labelPos, " binaryRead ");
+        // check for CRC32 verification
+        crc32Fuses = checkForString(buf, labelPos, " crc32 ");
+        // check for selective row re-write
+        repairRows = checkForString(buf, labelPos, " repair ");
+        // check for blank check
+        blankCheck = checkForString(buf, labelPos, " blankCheck ");
+        // check for compound erase-write-verify-secure operation
+        compoundOp = checkForString(buf, labelPos, " compound ");
+        // check for GAL type detection
+        detectType = checkForString(buf, labelPos, " detect ");
+        // check for timing profile upload
+        timingProfile = checkForString(buf, labelPos, " timing ");
+        // check for XSVF stream cache in the serial RAM
+        xsvfCache = checkForString(buf, labelPos, " xsvfCache ");
+        // check for fuse map slots in the serial RAM
+        fuseSlots = checkForString(buf, labelPos, " fuseSlots ");
+        // check for credit based flow control of the XSVF stream
+        xsvfCredit = checkForString(buf, labelPos, " xsvfCredit ");
         return RETV_OK; // all OK
     } // if
     if (verbose) {
@@ -350,6 +401,28 @@ int32_t waitForSerialPrompt(char* buf, int32_t bufSize, int32_t maxDelay) {
     return bufPos;
 } // WaitForSerialPrompt()
 
+// reads exactly 'len' bytes of binary data, returns the number of bytes read
+int32_t readSerialBytes(char* buf, int32_t len, int32_t maxDelay) {
+    int32_t bufPos = 0;
+    int32_t readSize;
+
+    while (bufPos < len && maxDelay > 0) {
+        readSize = serialDeviceRead(serialF, buf + bufPos, len - bufPos);
+        if (readSize > 0) {
+            bufPos += readSize;
+        } else {
+        /* WIN_API handles timeout itself */
+#ifndef _USE_WIN_API_
+            usleep(10 * 1000);
+            maxDelay -= 10;
+#else
+            maxDelay -= 30;
+#endif
+        } // else
+    } // while
+    return bufPos;
+} // readSerialBytes()
+
 char* printBuffer(char* bufPrint, int32_t readSize) {
     int32_t  i;
     bool     doPrint = true;
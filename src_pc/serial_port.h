@@ -51,6 +51,7 @@ bool    openSerial(void);
 void    closeSerial(void);
 int32_t checkPromptExists(char* buf, int32_t bufSize);
 int32_t waitForSerialPrompt(char* buf, int32_t bufSize, int32_t maxDelay);
+int32_t readSerialBytes(char* buf, int32_t len, int32_t maxDelay);
 char*   printBuffer(char* bufPrint, int32_t readSize);
 bool    sendBuffer(char* buf);
 int32_t sendLine(char* buf, int32_t bufSize, int32_t maxDelay);